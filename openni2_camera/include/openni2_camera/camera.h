@@ -28,9 +28,15 @@
 
 #include <openni2/OpenNI.h>
 
+#include <boost/shared_ptr.hpp>
+
+#include <string>
+
 namespace openni2_camera
 {
 
+class FrameWorkerPool;
+
 namespace internal
 {
   class CameraImpl;
@@ -39,8 +45,29 @@ namespace internal
 class Camera
 {
 public:
-  Camera(ros::NodeHandle& nh, ros::NodeHandle& nh_private, const openni::DeviceInfo& device_info);
+  /**
+   * Streams without a dedicated ~<stream>_processing_thread process their frames on pool, if given.
+   */
+  Camera(ros::NodeHandle& nh, ros::NodeHandle& nh_private, const openni::DeviceInfo& device_info, const boost::shared_ptr<FrameWorkerPool>& pool = boost::shared_ptr<FrameWorkerPool>());
   virtual ~Camera();
+
+  /**
+   * Serial number of the device, empty if it could not be read yet.
+   */
+  std::string serial() const;
+  std::string uri() const;
+
+  bool isConnected() const;
+
+  /**
+   * Called when the device was lost, streams stop but all topics stay advertised.
+   */
+  void disconnect();
+
+  /**
+   * Reopens the device, restores the last configuration and restarts the subscribed streams.
+   */
+  bool reconnect(const openni::DeviceInfo& device_info);
 private:
   internal::CameraImpl* impl_;
 };
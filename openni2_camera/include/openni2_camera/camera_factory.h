@@ -26,20 +26,59 @@
 
 #include <ros/ros.h>
 #include <openni2_camera/camera.h>
+#include <openni2_camera/openni_runtime.h>
+#include <openni2_camera/frame_worker.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <deque>
+#include <vector>
 
 namespace openni2_camera
 {
 
-class CameraFactory
+/**
+ * Opens cameras, create() can be called once per device. All factories of a process share the
+ * OpenNI runtime and, if ~processing_pool_threads is set, one frame processing thread pool.
+ *
+ * Cameras whose device is unplugged or fails are reopened by serial number as soon as OpenNI
+ * reports a device again, and at least every ~reconnect_interval seconds while they are lost.
+ */
+class CameraFactory :
+  public openni::OpenNI::DeviceConnectedListener,
+  public openni::OpenNI::DeviceDisconnectedListener,
+  public openni::OpenNI::DeviceStateChangedListener
 {
 public:
   CameraFactory();
   ~CameraFactory();
 
   bool create(ros::NodeHandle& nh, ros::NodeHandle& nh_private, const std::string& device_id);
+
+  virtual void onDeviceConnected(const openni::DeviceInfo* device_info);
+  virtual void onDeviceDisconnected(const openni::DeviceInfo* device_info);
+  virtual void onDeviceStateChanged(const openni::DeviceInfo* device_info, openni::DeviceState state);
 private:
-  openni2_camera::Camera *camera_;
-  bool initialized_;
+  boost::shared_ptr<OpenNIRuntime> runtime_;
+  boost::shared_ptr<FrameWorkerPool> pool_;
+
+  // guards all members below
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+
+  std::vector<openni2_camera::Camera*> cameras_;
+  std::deque<std::string> lost_uris_;
+  bool device_connected_, shutdown_;
+  double reconnect_interval_;
+  std::string cache_file_;
+
+  boost::thread reconnect_thread_;
+
+  void reconnectLoop();
+  bool reconnect(Camera& camera, const std::string& cache_file);
 };
 
 } /* namespace openni2_camera */
@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef DEPTH_QUANTIZER_H_
+#define DEPTH_QUANTIZER_H_
+
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+
+namespace openni2_camera
+{
+
+/**
+ * Depth dependent quantization of 16 bit depth images in millimeters.
+ *
+ * Structured light depth noise grows quadratically with distance, sigma(z) = noise_coefficient * z^2.
+ * The quantizer maps depth values to codes such that the reconstruction error never exceeds
+ * min(error_scale * sigma(z), max_error). Zero (invalid) depth is preserved exactly.
+ */
+class DepthQuantizer
+{
+public:
+  // sigma(z) in mm for z in mm, see Khoshelham and Elberink, "Accuracy and Resolution of Kinect Depth Data"
+  static const float DEFAULT_NOISE_COEFFICIENT;
+
+  // largest accepted parameters, larger errors than MAX_ERROR are meaningless for 16 bit depth
+  static const float MAX_ERROR_SCALE, MAX_ERROR, MAX_NOISE_COEFFICIENT;
+
+  DepthQuantizer(float error_scale = 0.5f, float max_error = 50.0f, float noise_coefficient = DEFAULT_NOISE_COEFFICIENT);
+
+  /**
+   * Whether the parameters are finite, not negative and within the limits above. Others still
+   * give a usable quantizer, but decoders should reject them as corrupt.
+   */
+  static bool isValid(float error_scale, float max_error, float noise_coefficient);
+
+  float errorScale() const { return error_scale_; }
+  float maxError() const { return max_error_; }
+  float noiseCoefficient() const { return noise_coefficient_; }
+
+  /**
+   * Maximum absolute reconstruction error in mm for the given depth.
+   */
+  float errorBound(uint16_t depth) const;
+
+  bool hasSameParameters(float error_scale, float max_error, float noise_coefficient) const;
+
+  void quantize(const uint16_t* depth, size_t num_pixels, uint16_t* codes) const;
+
+  void dequantize(const uint16_t* codes, size_t num_pixels, uint16_t* depth) const;
+private:
+  float error_scale_, max_error_, noise_coefficient_;
+  std::vector<uint16_t> codes_, depths_;
+};
+
+} /* namespace openni2_camera */
+#endif /* DEPTH_QUANTIZER_H_ */
@@ -0,0 +1,176 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef DEVICE_CLOCK_H_
+#define DEVICE_CLOCK_H_
+
+#include <ros/time.h>
+#include <sensor_msgs/Image.h>
+#include <openni2_camera/GetFrameset.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <stdint.h>
+#include <deque>
+#include <map>
+#include <string>
+
+namespace openni2_camera
+{
+
+/**
+ * Estimates how a device clock relates to the host clock. A frame arrives at its device time
+ * mapped to the host clock plus the USB and driver latency, which is never negative, so the
+ * mapping is fitted to the lower envelope of the arrival times: per second of device time the
+ * earliest arrival is kept, a line is fitted through these minima and shifted below all of them.
+ */
+class DeviceClockEstimator
+{
+public:
+  /**
+   * window is the number of seconds the estimate is based on.
+   */
+  DeviceClockEstimator(size_t window = 30);
+
+  /**
+   * device_timestamp in microseconds, as returned by VideoFrameRef::getTimestamp(). The streams of
+   * a device share its estimator, a sample is skipped instead of waiting while another stream
+   * holds it.
+   */
+  void update(uint64_t device_timestamp, const ros::Time& arrival);
+
+  /**
+   * Recordings are replayed at an arbitrary speed, so instead of fitting the arrival times the
+   * first frame is anchored at its arrival and the recorded time differences are kept.
+   */
+  void setPlayback(bool playback);
+
+  /**
+   * Anchors the next frame anew, e.g. after seeking.
+   */
+  void restart();
+
+  bool isValid() const;
+
+  ros::Time toHostTime(uint64_t device_timestamp) const;
+
+  /**
+   * Host time minus device time at the latest sample, in seconds.
+   */
+  double offset() const;
+  double drift() const;
+  double jitter() const;
+  uint64_t samples() const;
+private:
+  struct Bucket
+  {
+    int64_t index;
+    double device_time, delay;
+  };
+
+  mutable boost::mutex mutex_;
+  size_t window_;
+
+  bool has_origin_;
+  uint64_t device_origin_, last_device_timestamp_;
+  ros::Time host_origin_;
+
+  std::deque<Bucket> buckets_;
+  bool valid_;
+  double intercept_, slope_, jitter_;
+  uint64_t samples_;
+  bool playback_;
+
+  void reset(uint64_t device_timestamp, const ros::Time& arrival);
+  void fit();
+};
+
+/**
+ * Recent frames of one stream for nearest frameset requests. Each stream owns its history, so
+ * publishing a frame only locks the history of that stream.
+ */
+class FrameHistory
+{
+public:
+  FrameHistory(size_t size);
+
+  /**
+   * image may be null, only the header is remembered then.
+   */
+  void add(const std_msgs::Header& header, const sensor_msgs::ImageConstPtr& image);
+
+  /**
+   * Stamp of the latest frame, false if there is none yet.
+   */
+  bool latest(ros::Time& stamp) const;
+
+  /**
+   * The frame nearest to stamp, false if there is none yet.
+   */
+  bool nearest(const ros::Time& stamp, std_msgs::Header& header, sensor_msgs::ImageConstPtr& image) const;
+private:
+  struct Frame
+  {
+    std_msgs::Header header;
+    sensor_msgs::ImageConstPtr image;
+  };
+
+  mutable boost::mutex mutex_;
+  size_t size_;
+  std::deque<Frame> frames_;
+};
+
+/**
+ * Process wide registry of the device clocks and the frame histories of all streams, answers
+ * nearest frameset requests across cameras. Frames never pass through it, its lock is only taken
+ * when streams come and go and for requests.
+ */
+class MultiDeviceClock
+{
+public:
+  static MultiDeviceClock& instance();
+
+  /**
+   * The estimator of the device, created on first use.
+   */
+  boost::shared_ptr<DeviceClockEstimator> clock(const std::string& device);
+
+  void addStream(const std::string& stream, const boost::shared_ptr<FrameHistory>& history);
+
+  /**
+   * Removes the stream if it is still registered with this history.
+   */
+  void removeStream(const std::string& stream, const boost::shared_ptr<FrameHistory>& history);
+
+  bool getFrameset(GetFrameset::Request& request, GetFrameset::Response& response) const;
+private:
+  MultiDeviceClock();
+
+  mutable boost::mutex mutex_;
+  std::map<std::string, boost::shared_ptr<DeviceClockEstimator> > clocks_;
+  std::map<std::string, boost::shared_ptr<FrameHistory> > streams_;
+};
+
+} /* namespace openni2_camera */
+#endif /* DEVICE_CLOCK_H_ */
@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef DEVICE_INDEX_H_
+#define DEVICE_INDEX_H_
+
+#include <openni2/OpenNI.h>
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace openni2_camera
+{
+
+struct UsbLocation
+{
+  uint16_t vendor_id, product_id;
+  unsigned bus, address;
+};
+
+/**
+ * Parses OpenNI USB device URIs of the form "vid/pid@bus/address", e.g. "1d27/0601@2/3".
+ */
+bool parseUsbUri(const std::string& uri, UsbLocation& location);
+
+/**
+ * Directory for files cached between runs, $ROS_HOME/openni2_camera. It is created if necessary,
+ * returns an empty string if that fails.
+ */
+std::string cacheDirectory();
+
+/**
+ * Replaces file with content through a uniquely named temporary file in the same directory, so
+ * concurrent writers never mix their contents and readers never see a partial file.
+ */
+bool replaceFile(const std::string& file, const std::string& content);
+
+/**
+ * Resolves device ids to the devices currently attached. Serial numbers can only be read from an
+ * opened device, so the serial to URI mapping is cached in a file. A cached entry is validated by
+ * opening just that device, only on a miss are all candidates probed, in parallel.
+ */
+class DeviceIndex
+{
+public:
+  /**
+   * An empty cache_file disables the cache.
+   */
+  DeviceIndex(const std::string& cache_file);
+
+  /**
+   * Enumerates the attached devices.
+   */
+  void update();
+
+  const std::vector<openni::DeviceInfo>& devices() const { return devices_; }
+
+  bool findByUri(const std::string& uri, openni::DeviceInfo& device) const;
+
+  /**
+   * An address of 0 selects the first device on the bus.
+   */
+  bool findByBusAddress(unsigned bus, unsigned address, openni::DeviceInfo& device) const;
+
+  /**
+   * Devices with an URI in excluded_uris are not opened, e.g. because they are already in use.
+   */
+  bool findBySerial(const std::string& serial, const std::set<std::string>& excluded_uris, openni::DeviceInfo& device);
+
+  static bool readSerial(const std::string& uri, std::string& serial);
+private:
+  std::string cache_file_;
+  std::vector<openni::DeviceInfo> devices_;
+
+  // serial -> uri
+  std::map<std::string, std::string> cache_;
+
+  const openni::DeviceInfo* findByUri(const std::string& uri) const;
+
+  void load();
+  void save() const;
+};
+
+} /* namespace openni2_camera */
+#endif /* DEVICE_INDEX_H_ */
@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef DEVICE_PROFILE_H_
+#define DEVICE_PROFILE_H_
+
+#include <openni2/OpenNI.h>
+
+#include <string>
+#include <vector>
+
+namespace openni2_camera
+{
+
+/**
+ * Capabilities of a device. Querying them costs several USB control transfers, so they are cached
+ * per serial number and only queried again if the firmware or driver version changed.
+ */
+struct DeviceProfile
+{
+  struct Mode
+  {
+    openni::SensorType sensor;
+    openni::VideoMode mode;
+  };
+
+  std::string serial, firmware, hardware, driver, vendor, name;
+  bool registration_supported;
+  std::vector<Mode> modes;
+
+  DeviceProfile();
+
+  /**
+   * False if the sensor is unknown, i.e. no mode of it is in the profile.
+   */
+  bool knowsSensor(openni::SensorType sensor) const;
+  bool supports(openni::SensorType sensor, const openni::VideoMode& mode) const;
+
+  /**
+   * Queries everything from the opened device.
+   */
+  void query(openni::Device& device);
+
+  /**
+   * Loads the cached profile of the opened device, valid if its firmware and driver versions still
+   * match those of the device.
+   */
+  bool load(const std::string& file, openni::Device& device);
+  bool save(const std::string& file) const;
+
+  static std::string readProperty(openni::Device& device, int property);
+};
+
+} /* namespace openni2_camera */
+#endif /* DEVICE_PROFILE_H_ */
@@ -0,0 +1,174 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FRAME_LOG_H_
+#define FRAME_LOG_H_
+
+#include <ros/time.h>
+
+#include <boost/thread/mutex.hpp>
+
+#include <stdint.h>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace openni2_camera
+{
+
+/**
+ * Append-only log of raw frames for offline tools, which map it instead of deserializing a bag.
+ *
+ * Layout, little endian: a 64 byte file header
+ *   uint32 magic "ONFL", uint32 version
+ * followed by records of a 128 byte header
+ *   uint32 magic "ONFR", uint32 data_size, uint64 frame_index, uint64 device_timestamp (us),
+ *   int32 stamp_sec, uint32 stamp_nsec, uint32 width, uint32 height, uint32 step,
+ *   int32 pixel_format (openni::PixelFormat), int32 fps, char stream[32], char encoding[32]
+ * and the frame data, padded to a multiple of 64 bytes so mapped frames stay aligned.
+ *
+ * The sidecar index <file>.idx has a 64 byte header
+ *   uint32 magic "ONFI", uint32 version
+ * followed by 16 byte entries in the order of the records
+ *   uint64 offset of the record, int32 stamp_sec, uint32 stamp_nsec
+ * Records missing from the index, e.g. after a crash, are recovered by scanning the log, which is
+ * also done from the first entry that does not point to the record following the previous one.
+ */
+struct FrameLogRecord
+{
+  std::string stream;
+  uint64_t frame_index;
+  uint64_t device_timestamp;
+  ros::Time stamp;
+  uint32_t width, height, step;
+  int32_t pixel_format, fps;
+  std::string encoding;
+};
+
+struct FrameLogView
+{
+  FrameLogRecord record;
+  const uint8_t* data;
+  size_t size;
+};
+
+class FrameLogWriter
+{
+public:
+  FrameLogWriter();
+  ~FrameLogWriter();
+
+  /**
+   * Creates or replaces the log and its index.
+   */
+  bool open(const std::string& file);
+
+  void close();
+
+  bool isValid() const;
+
+  const std::string& file() const { return file_; }
+
+  /**
+   * Appends a frame, may be called from several threads. Blocks until the frame is written, use
+   * FrameLogQueue to write from the frame path. The log is closed on a write error.
+   */
+  bool append(const FrameLogRecord& record, const uint8_t* data, size_t size);
+
+  uint64_t frames() const;
+  uint64_t bytes() const;
+private:
+  mutable boost::mutex mutex_;
+  std::string file_;
+  int fd_, index_fd_;
+  uint64_t offset_, frames_;
+};
+
+class FrameLogReader
+{
+public:
+  FrameLogReader();
+  ~FrameLogReader();
+
+  bool open(const std::string& file);
+
+  void close();
+
+  bool isValid() const { return data_ != 0; }
+
+  const std::string& file() const { return file_; }
+
+  /**
+   * Number of frames, in the order they were written.
+   */
+  size_t size() const;
+
+  /**
+   * Maps the frame without copying, the view is valid until the reader is closed.
+   */
+  bool read(size_t idx, FrameLogView& view) const;
+
+  ros::Time stamp(size_t idx) const;
+
+  /**
+   * Names of the logged streams.
+   */
+  std::vector<std::string> streams() const;
+
+  /**
+   * Index of the first frame of stream stamped at or after stamp, size() if there is none.
+   */
+  size_t find(const ros::Time& stamp, const std::string& stream) const;
+
+  /**
+   * Index of the first frame of any stream stamped at or after stamp, size() if there is none.
+   * The streams are interleaved in the order their frames were processed, so frames of other
+   * streams stamped before stamp may still follow it.
+   */
+  size_t find(const ros::Time& stamp) const;
+private:
+  struct Entry
+  {
+    uint64_t offset;
+    ros::Time stamp;
+  };
+
+  std::string file_;
+  const uint8_t* data_;
+  size_t size_;
+  const uint8_t* index_;
+  size_t index_size_, indexed_;
+  // records missing from the index
+  std::vector<Entry> recovered_;
+  // frames of each stream in the order they were written, their stamps are sorted
+  std::map<std::string, std::vector<size_t> > streams_;
+
+  Entry entry(size_t idx) const;
+  Entry indexEntry(size_t idx) const;
+  void recover();
+  void indexStreams();
+};
+
+} /* namespace openni2_camera */
+#endif /* FRAME_LOG_H_ */
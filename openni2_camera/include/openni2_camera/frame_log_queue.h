@@ -0,0 +1,98 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FRAME_LOG_QUEUE_H_
+#define FRAME_LOG_QUEUE_H_
+
+#include <openni2_camera/frame_log.h>
+#include <openni2_camera/frame_worker.h>
+
+#include <sensor_msgs/Image.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <deque>
+#include <string>
+
+namespace openni2_camera
+{
+
+/**
+ * Writes frames to a frame log in the background, so the frame path never waits for the disk.
+ * The queue holds the published image messages, so published frames are written without a copy.
+ * Frames which do not fit into the queue are dropped.
+ */
+class FrameLogQueue
+{
+public:
+  /**
+   * Takes over the open writer, max_bytes limits the queued frames, zero means no limit.
+   */
+  FrameLogQueue(const boost::shared_ptr<FrameLogWriter>& writer, size_t max_bytes, const ThreadOptions& options);
+
+  /**
+   * Writes the queued frames and closes the log.
+   */
+  ~FrameLogQueue();
+
+  /**
+   * Queues the frame, returns false if it was dropped.
+   */
+  bool add(const FrameLogRecord& record, const sensor_msgs::ImageConstPtr& image);
+
+  /**
+   * Writes the queued frames and closes the log, later frames are dropped.
+   */
+  void close();
+
+  const std::string& file() const { return writer_->file(); }
+
+  uint64_t frames() const { return writer_->frames(); }
+
+  uint64_t droppedFrames() const;
+private:
+  struct Frame
+  {
+    FrameLogRecord record;
+    sensor_msgs::ImageConstPtr image;
+  };
+
+  boost::shared_ptr<FrameLogWriter> writer_;
+  size_t max_bytes_;
+
+  mutable boost::mutex mutex_;
+  boost::condition_variable condition_;
+  std::deque<Frame> queue_;
+  size_t bytes_;
+  uint64_t dropped_;
+  bool stop_;
+  boost::thread thread_;
+
+  void run(ThreadOptions options);
+};
+
+} /* namespace openni2_camera */
+#endif /* FRAME_LOG_QUEUE_H_ */
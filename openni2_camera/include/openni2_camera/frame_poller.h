@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FRAME_POLLER_H_
+#define FRAME_POLLER_H_
+
+#include <openni2_camera/frame_worker.h>
+
+#include <vector>
+
+namespace openni2_camera
+{
+
+/**
+ * Acquires the frames of all added streams on a single thread using OpenNI::waitForAnyStream,
+ * instead of the per stream callbacks of VideoStream::NewFrameListener.
+ *
+ * Frames which become ready within batch_window of the first one are read as one batch, stamped
+ * with the time the batch arrived and processed in a fixed order: depth, color, ir. So depth and
+ * color frames captured together get identical stamps. While a batch is processed the driver only
+ * keeps the latest frame of each stream, frames which arrive in between are dropped.
+ */
+class FramePoller
+{
+public:
+  typedef boost::function<void(const openni::VideoFrameRef&, const ros::Time&)> Callback;
+
+  FramePoller(const ThreadOptions& options, const ros::WallDuration& batch_window);
+  ~FramePoller();
+
+  /**
+   * Adds a started stream, replacing the callback if it was already added. Takes effect with the
+   * next poll, which starts within POLL_TIMEOUT_MS.
+   */
+  void add(openni::VideoStream& stream, const Callback& callback);
+
+  /**
+   * Removes the stream, has to be called before the stream is stopped and not from a callback.
+   * Waits for the current poll to finish, when this returns the callback is no longer executed.
+   */
+  void remove(openni::VideoStream& stream);
+private:
+  struct Entry
+  {
+    openni::VideoStream* stream;
+    Callback callback;
+    int rank;
+  };
+
+  struct Frame
+  {
+    openni::VideoFrameRef frame;
+    Callback callback;
+    int rank;
+
+    bool operator<(const Frame& other) const
+    {
+      return rank < other.rank;
+    }
+  };
+
+  ThreadOptions options_;
+  ros::WallDuration batch_window_;
+
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+  std::vector<Entry> entries_;
+  // polling_ is set while the thread works on a copy of entries_, generation_ counts the polls
+  bool polling_, stop_;
+  uint64_t generation_;
+
+  boost::thread thread_;
+
+  void run();
+
+  void readBatch(const std::vector<Entry>& entries, int first, std::vector<Frame>& batch);
+};
+
+} /* namespace openni2_camera */
+#endif /* FRAME_POLLER_H_ */
@@ -0,0 +1,64 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FRAME_STATISTICS_H_
+#define FRAME_STATISTICS_H_
+
+#include <openni2/OpenNI.h>
+#include <openni2_camera/FrameStatistics.h>
+
+namespace openni2_camera
+{
+
+/**
+ * Copies OpenNI frames row by row and, optionally, computes FrameStatistics on each row while
+ * it is still in cache, so monitoring costs no extra pass over the frame.
+ */
+class FrameStatisticsCollector
+{
+public:
+  FrameStatisticsCollector();
+
+  /**
+   * Splits [0, max_value) into bins of equal integer size, rounded up.
+   */
+  void setHistogram(uint32_t bins, float max_value);
+
+  /**
+   * Value at which 16 bit gray pixels count as saturated.
+   */
+  void setSaturationValue(uint16_t value);
+
+  /**
+   * Copies the frame into output, which has to provide frame.getDataSize() bytes. Either output
+   * or statistics may be null.
+   */
+  void process(const openni::VideoFrameRef& frame, uint8_t* output, FrameStatistics* statistics) const;
+private:
+  uint32_t histogram_bins_;
+  uint32_t histogram_bin_size_;
+  uint16_t saturation_value_;
+};
+
+} /* namespace openni2_camera */
+#endif /* FRAME_STATISTICS_H_ */
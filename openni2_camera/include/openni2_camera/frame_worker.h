@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FRAME_WORKER_H_
+#define FRAME_WORKER_H_
+
+#include <ros/ros.h>
+#include <openni2/OpenNI.h>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <deque>
+
+namespace openni2_camera
+{
+
+/**
+ * Placement and scheduling of a driver thread.
+ */
+struct ThreadOptions
+{
+  std::string name;
+  std::vector<int> cpu_affinity;
+  // > 0 selects SCHED_FIFO with this priority, otherwise the default scheduler with nice
+  int fifo_priority;
+  int nice;
+
+  ThreadOptions();
+
+  /**
+   * Reads <prefix>_thread_name, <prefix>_thread_affinity (comma separated cpu ids),
+   * <prefix>_thread_priority and <prefix>_thread_nice.
+   */
+  static ThreadOptions fromParameters(const ros::NodeHandle& nh, const std::string& prefix, const std::string& default_name);
+
+  /**
+   * Applies the options to the calling thread, failures are logged.
+   */
+  void applyToCurrentThread() const;
+};
+
+class FrameWorker;
+
+/**
+ * Threads which process the frames of several FrameWorkers.
+ */
+class FrameWorkerPool
+{
+public:
+  FrameWorkerPool(const ThreadOptions& options, size_t num_threads);
+  ~FrameWorkerPool();
+
+  size_t size() const { return num_threads_; }
+
+  /**
+   * The pool shared by all cameras of the process. It is created with the given options by the
+   * first caller and destroyed when the last user releases it.
+   */
+  static boost::shared_ptr<FrameWorkerPool> shared(const ThreadOptions& options, size_t num_threads);
+private:
+  friend class FrameWorker;
+
+  ThreadOptions options_;
+  size_t num_threads_;
+
+  boost::mutex mutex_;
+  boost::condition_variable work_condition_, idle_condition_;
+  std::deque<FrameWorker*> queue_;
+  bool stop_;
+
+  boost::thread_group threads_;
+
+  void run();
+};
+
+/**
+ * Processes the frames of one stream on a dedicated thread or a FrameWorkerPool. Only the latest
+ * frame is kept, if processing falls behind older frames are dropped instead of queuing up
+ * latency. At most one frame of a worker is processed at a time, so the callback never runs
+ * concurrently with itself.
+ */
+class FrameWorker
+{
+public:
+  /**
+   * Called with the frame, its published stamp and its arrival on the host.
+   */
+  typedef boost::function<void(const openni::VideoFrameRef&, const ros::Time&, const ros::Time&)> Callback;
+
+  FrameWorker(const ThreadOptions& options, const Callback& callback);
+  FrameWorker(const boost::shared_ptr<FrameWorkerPool>& pool, const Callback& callback);
+
+  /**
+   * Waits for a frame in progress, pending frames are discarded.
+   */
+  ~FrameWorker();
+
+  /**
+   * Returns true if the frame replaced a pending frame which was never processed.
+   */
+  bool submit(const openni::VideoFrameRef& frame, const ros::Time& stamp, const ros::Time& arrival);
+private:
+  friend class FrameWorkerPool;
+
+  boost::shared_ptr<FrameWorkerPool> pool_;
+  Callback callback_;
+
+  // guarded by the mutex of the pool
+  openni::VideoFrameRef pending_frame_;
+  ros::Time pending_stamp_, pending_arrival_;
+  bool has_pending_, queued_, active_;
+};
+
+} /* namespace openni2_camera */
+#endif /* FRAME_WORKER_H_ */
@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef LITTLE_ENDIAN_H_
+#define LITTLE_ENDIAN_H_
+
+#include <stdint.h>
+#include <cstring>
+
+namespace openni2_camera
+{
+
+namespace internal
+{
+
+// byte order independent helpers for the headers of the compressed image and frame log formats
+
+inline void writeUInt32(uint8_t* p, uint32_t value)
+{
+  p[0] = uint8_t(value);
+  p[1] = uint8_t(value >> 8);
+  p[2] = uint8_t(value >> 16);
+  p[3] = uint8_t(value >> 24);
+}
+
+inline uint32_t readUInt32(const uint8_t* p)
+{
+  return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+inline void writeUInt64(uint8_t* p, uint64_t value)
+{
+  writeUInt32(p, uint32_t(value));
+  writeUInt32(p + 4, uint32_t(value >> 32));
+}
+
+inline uint64_t readUInt64(const uint8_t* p)
+{
+  return uint64_t(readUInt32(p)) | (uint64_t(readUInt32(p + 4)) << 32);
+}
+
+inline void writeFloat(uint8_t* p, float value)
+{
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  writeUInt32(p, bits);
+}
+
+inline float readFloat(const uint8_t* p)
+{
+  uint32_t bits = readUInt32(p);
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+} /* namespace internal */
+
+} /* namespace openni2_camera */
+#endif /* LITTLE_ENDIAN_H_ */
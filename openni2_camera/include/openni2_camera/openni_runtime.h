@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef OPENNI_RUNTIME_H_
+#define OPENNI_RUNTIME_H_
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <set>
+#include <string>
+
+namespace openni2_camera
+{
+
+/**
+ * Reference counted OpenNI library. OpenNI is initialized when the first user acquires the
+ * runtime and shut down when the last one releases it, so several cameras can live in one
+ * process, e.g. in the same nodelet manager.
+ */
+class OpenNIRuntime : private boost::noncopyable
+{
+public:
+  static boost::shared_ptr<OpenNIRuntime> acquire();
+
+  ~OpenNIRuntime();
+
+  bool isInitialized() const { return initialized_; }
+
+  /**
+   * Marks the device as used by this process. Returns false if another camera already claimed it.
+   */
+  bool claimDevice(const std::string& uri);
+  void releaseDevice(const std::string& uri);
+
+  std::set<std::string> claimedDevices() const;
+private:
+  OpenNIRuntime();
+
+  bool initialized_;
+  std::set<std::string> claimed_devices_;
+};
+
+} /* namespace openni2_camera */
+#endif /* OPENNI_RUNTIME_H_ */
@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PRE_TRIGGER_RING_H_
+#define PRE_TRIGGER_RING_H_
+
+#include <openni2_camera/frame_log.h>
+#include <openni2_camera/frame_worker.h>
+
+#include <ros/time.h>
+#include <sensor_msgs/Image.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <deque>
+#include <string>
+
+namespace openni2_camera
+{
+
+/**
+ * Keeps the latest frames of several streams in memory, bounded by their time span and size, and
+ * dumps them together with the frames of a following period to a frame log in the background.
+ * The ring holds the published image messages, so published frames are kept without a copy.
+ */
+class PreTriggerRing
+{
+public:
+  /**
+   * max_duration in seconds and max_bytes limit the ring, zero means no limit.
+   */
+  PreTriggerRing(double max_duration, size_t max_bytes, const ThreadOptions& dump_options);
+  ~PreTriggerRing();
+
+  void add(const FrameLogRecord& record, const sensor_msgs::ImageConstPtr& image);
+
+  /**
+   * Starts writing the frames in the ring and those of the next post_duration seconds to file.
+   * Fails if the previous dump is still running.
+   */
+  bool dump(const std::string& file, double post_duration, std::string& message);
+
+  bool isDumping() const;
+private:
+  struct Frame
+  {
+    FrameLogRecord record;
+    sensor_msgs::ImageConstPtr image;
+  };
+
+  ThreadOptions dump_options_;
+  double max_duration_;
+  size_t max_bytes_;
+
+  mutable boost::mutex mutex_;
+  boost::condition_variable condition_;
+  std::deque<Frame> ring_;
+  size_t bytes_;
+
+  // frames to dump, the ring's at the trigger and the following ones up to the deadline
+  std::deque<Frame> pending_;
+  boost::shared_ptr<FrameLogWriter> writer_;
+  ros::Time dump_deadline_;
+  ros::WallTime dump_wall_deadline_;
+  bool dumping_, stop_;
+  boost::thread dump_thread_;
+
+  void dumpLoop();
+};
+
+} /* namespace openni2_camera */
+#endif /* PRE_TRIGGER_RING_H_ */
@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PUBLISHED_IMAGE_REGISTRY_H_
+#define PUBLISHED_IMAGE_REGISTRY_H_
+
+#include <sensor_msgs/Image.h>
+
+#include <boost/thread/mutex.hpp>
+
+#include <vector>
+
+namespace openni2_camera
+{
+
+/**
+ * Remembers the most recently published images of this process. A nodelet loaded into the same
+ * manager can check whether it received the driver's message or a copy of it. The registry is
+ * disabled until such a nodelet enables it, so the frame path does not take its lock otherwise.
+ */
+class PublishedImageRegistry
+{
+public:
+  static PublishedImageRegistry& instance();
+
+  /**
+   * Images published afterwards are remembered.
+   */
+  static void enable();
+
+  static bool isEnabled();
+
+  void add(const sensor_msgs::ImageConstPtr& image);
+
+  /**
+   * True if image is one of the recently published messages and not a copy of it.
+   */
+  bool contains(const sensor_msgs::ImageConstPtr& image) const;
+private:
+  struct Entry
+  {
+    const sensor_msgs::Image* message;
+    const uint8_t* data;
+    ros::Time stamp;
+  };
+
+  // set with a __sync builtin, boost::atomic needs a newer boost than supported
+  static volatile int enabled_;
+
+  PublishedImageRegistry();
+
+  mutable boost::mutex mutex_;
+  std::vector<Entry> entries_;
+  size_t next_;
+};
+
+} /* namespace openni2_camera */
+#endif /* PUBLISHED_IMAGE_REGISTRY_H_ */
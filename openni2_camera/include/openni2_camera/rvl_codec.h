@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef RVL_CODEC_H_
+#define RVL_CODEC_H_
+
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+
+namespace openni2_camera
+{
+
+/**
+ * Lossless codec for 16 bit depth images based on "Fast Lossless Depth Image
+ * Compression" (A. D. Wilson, 2017). Runs of zero (invalid) pixels are run-length
+ * encoded, valid pixels are stored as zigzag encoded deltas to their predecessor.
+ * All counts and deltas use a variable length code of 4 bit nibbles.
+ *
+ * The encoded stream is a sequence of little endian 32 bit words.
+ */
+class RvlCodec
+{
+public:
+  /**
+   * Upper bound of the encoded size in bytes for the given number of pixels.
+   */
+  static size_t maxEncodedSize(size_t num_pixels);
+
+  /**
+   * Encodes num_pixels pixels into output, which has to provide maxEncodedSize(num_pixels)
+   * bytes. Returns the number of bytes written.
+   */
+  static size_t encode(const uint16_t* input, size_t num_pixels, uint8_t* output);
+
+  /**
+   * Encodes num_pixels pixels and appends the result to output.
+   */
+  static void encode(const uint16_t* input, size_t num_pixels, std::vector<uint8_t>& output);
+
+  /**
+   * Upper bound of the pixels input_size bytes can encode, to reject implausible sizes before
+   * allocating the output.
+   */
+  static size_t maxDecodedPixels(size_t input_size);
+
+  /**
+   * Decodes exactly num_pixels pixels. Returns false if the input is truncated or corrupt.
+   */
+  static bool decode(const uint8_t* input, size_t input_size, uint16_t* output, size_t num_pixels);
+};
+
+} /* namespace openni2_camera */
+#endif /* RVL_CODEC_H_ */
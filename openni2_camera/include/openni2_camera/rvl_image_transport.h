@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef RVL_IMAGE_TRANSPORT_H_
+#define RVL_IMAGE_TRANSPORT_H_
+
+#include <image_transport/simple_publisher_plugin.h>
+#include <image_transport/simple_subscriber_plugin.h>
+#include <sensor_msgs/CompressedImage.h>
+
+#include <openni2_camera/depth_quantizer.h>
+
+#include <boost/scoped_ptr.hpp>
+
+namespace openni2_camera
+{
+
+/**
+ * Encodes a 16UC1/MONO16 image into the "rvl" transport format. Returns false for other encodings
+ * and for images whose step or data is too small for their width and height.
+ */
+bool encodeRvlImage(const sensor_msgs::Image& image, sensor_msgs::CompressedImage& compressed);
+
+/**
+ * Decodes an image published by the "rvl" transport. Returns false if the data is corrupt,
+ * including sizes above 65536 pixels per side or 2^26 pixels, which are rejected before allocating.
+ */
+bool decodeRvlImage(const sensor_msgs::CompressedImage& compressed, sensor_msgs::Image& image);
+
+/**
+ * Quantizes a 16UC1 depth image in millimeters with the given quantizer and encodes the codes
+ * into the "rvl_lossy" transport format. Returns false for other encodings and for images whose
+ * step or data is too small for their width and height.
+ */
+bool encodeLossyDepthImage(const sensor_msgs::Image& image, const DepthQuantizer& quantizer, sensor_msgs::CompressedImage& compressed);
+
+/**
+ * Decodes an image published by the "rvl_lossy" transport. The quantizer is replaced if the
+ * image was encoded with different parameters. Returns false if the data is corrupt.
+ */
+bool decodeLossyDepthImage(const sensor_msgs::CompressedImage& compressed, boost::scoped_ptr<DepthQuantizer>& quantizer, sensor_msgs::Image& image);
+
+class RvlPublisher : public image_transport::SimplePublisherPlugin<sensor_msgs::CompressedImage>
+{
+public:
+  virtual ~RvlPublisher() {}
+
+  virtual std::string getTransportName() const
+  {
+    return "rvl";
+  }
+protected:
+  virtual void publish(const sensor_msgs::Image& message, const PublishFn& publish_fn) const;
+};
+
+class RvlSubscriber : public image_transport::SimpleSubscriberPlugin<sensor_msgs::CompressedImage>
+{
+public:
+  virtual ~RvlSubscriber() {}
+
+  virtual std::string getTransportName() const
+  {
+    return "rvl";
+  }
+protected:
+  virtual void internalCallback(const sensor_msgs::CompressedImageConstPtr& message, const Callback& user_cb);
+};
+
+class RvlLossyPublisher : public image_transport::SimplePublisherPlugin<sensor_msgs::CompressedImage>
+{
+public:
+  virtual ~RvlLossyPublisher() {}
+
+  virtual std::string getTransportName() const
+  {
+    return "rvl_lossy";
+  }
+protected:
+  mutable boost::scoped_ptr<DepthQuantizer> quantizer_;
+
+  virtual void publish(const sensor_msgs::Image& message, const PublishFn& publish_fn) const;
+};
+
+class RvlLossySubscriber : public image_transport::SimpleSubscriberPlugin<sensor_msgs::CompressedImage>
+{
+public:
+  virtual ~RvlLossySubscriber() {}
+
+  virtual std::string getTransportName() const
+  {
+    return "rvl_lossy";
+  }
+protected:
+  boost::scoped_ptr<DepthQuantizer> quantizer_;
+
+  virtual void internalCallback(const sensor_msgs::CompressedImageConstPtr& message, const Callback& user_cb);
+};
+
+} /* namespace openni2_camera */
+#endif /* RVL_IMAGE_TRANSPORT_H_ */
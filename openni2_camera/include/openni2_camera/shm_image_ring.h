@@ -0,0 +1,138 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SHM_IMAGE_RING_H_
+#define SHM_IMAGE_RING_H_
+
+#include <ros/time.h>
+
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+
+namespace openni2_camera
+{
+
+/**
+ * POSIX shared memory ring of images for consumers on the same host which cannot be loaded into
+ * the driver's nodelet manager. Only a small notification crosses ROS, the image is read directly
+ * from the mapping.
+ *
+ * Layout, native byte order: a 4096 byte ring header
+ *   uint32 magic "ONSR", uint32 version, uint32 slot_count, uint32 reserved,
+ *   uint64 slot_size, uint64 write_sequence (number of reserved slots)
+ * followed by slot_count slots of slot_size bytes, each starting with a 256 byte slot header
+ *   uint64 state, uint32 width, uint32 height, uint32 step, uint32 data_size,
+ *   int32 stamp_sec, uint32 stamp_nsec, char encoding[32]
+ * and the image data. Sequence n is written to slot n % slot_count. Writers reserve sequences
+ * with an atomic increment of write_sequence. The state of a slot is 2n + 1 while sequence n is
+ * written and 2n + 2 once it is complete. Readers check the state before and after using the
+ * data, a changed state means the writer lapped them.
+ */
+struct ShmImageView
+{
+  uint64_t sequence;
+  uint32_t width, height, step;
+  std::string encoding;
+  ros::Time stamp;
+  const uint8_t* data;
+  size_t size;
+};
+
+class ShmImageRingWriter
+{
+public:
+  ShmImageRingWriter();
+  ~ShmImageRingWriter();
+
+  /**
+   * Creates or replaces the segment, slot_size is the maximum image size in bytes.
+   */
+  bool create(const std::string& name, uint32_t slot_count, size_t slot_size);
+
+  void destroy();
+
+  bool isValid() const { return header_ != 0; }
+
+  const std::string& name() const { return name_; }
+  uint32_t slotCount() const;
+  size_t maxImageSize() const;
+
+  /**
+   * Reserves the next slot and returns a pointer to size bytes of image data, 0 if the image
+   * does not fit. Has to be followed by commit().
+   */
+  uint8_t* begin(size_t size, uint64_t& sequence);
+
+  void commit(uint64_t sequence, uint32_t width, uint32_t height, uint32_t step, const std::string& encoding, const ros::Time& stamp);
+private:
+  std::string name_;
+  uint8_t* header_;
+  size_t size_;
+};
+
+class ShmImageRingReader
+{
+public:
+  enum Result
+  {
+    IMAGE_READ,
+    // the writer has not completed the slot yet
+    IMAGE_NOT_READY,
+    // the reader lagged behind and the slot was reused for a later image
+    IMAGE_OVERWRITTEN
+  };
+
+  ShmImageRingReader();
+  ~ShmImageRingReader();
+
+  bool open(const std::string& name);
+
+  void close();
+
+  bool isValid() const { return header_ != 0; }
+
+  const std::string& name() const { return name_; }
+
+  /**
+   * Maps the image with the given sequence without copying. The view stays readable while the
+   * segment is open, but the data is only consistent if isValid(view) still holds afterwards.
+   */
+  Result read(uint64_t sequence, ShmImageView& view) const;
+
+  bool isValid(const ShmImageView& view) const;
+
+  /**
+   * Number of images written after the given one, the image is overwritten at slot_count.
+   */
+  uint64_t lag(uint64_t sequence) const;
+
+  uint32_t slotCount() const;
+private:
+  std::string name_;
+  const uint8_t* header_;
+  size_t size_;
+};
+
+} /* namespace openni2_camera */
+#endif /* SHM_IMAGE_RING_H_ */
@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef TILE_DELTA_CODEC_H_
+#define TILE_DELTA_CODEC_H_
+
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+
+namespace openni2_camera
+{
+
+/**
+ * Temporal delta coding for mostly static scenes. The image is split into square tiles and only
+ * tiles which changed since the last transmitted frame are encoded. Every keyframe_interval frames,
+ * and whenever forceKeyframe() was called, all tiles are sent so late joiners and decoders which
+ * missed a frame can resynchronize.
+ *
+ * A tile counts as unchanged if no sample differs by more than threshold from what the decoder
+ * already holds, so the reconstruction error is bounded by threshold and does not accumulate.
+ * A threshold of 0 makes the codec lossless.
+ *
+ * Layout: 28 byte header (magic, width, height, bytes per pixel, tile size, sequence, flags),
+ * a bitmap with one bit per tile in row major order, followed by the rows of each changed tile.
+ * Width, height and tile size are limited to 65536 and pixels to 8 bytes, the decoder rejects
+ * larger ones as corrupt.
+ */
+class TileDeltaEncoder
+{
+public:
+  TileDeltaEncoder(uint32_t tile_size = 32, uint32_t keyframe_interval = 30, uint32_t threshold = 0);
+
+  void setParameters(uint32_t tile_size, uint32_t keyframe_interval, uint32_t threshold);
+
+  void forceKeyframe();
+
+  /**
+   * Encodes the image and replaces the content of output. bytes_per_sample has to be 1 or 2,
+   * 16 bit samples are expected in host byte order. Returns true if a keyframe was written.
+   */
+  bool encode(const uint8_t* data, uint32_t width, uint32_t height, uint32_t step, uint32_t bytes_per_pixel, uint32_t bytes_per_sample, std::vector<uint8_t>& output);
+private:
+  uint32_t tile_size_, keyframe_interval_, threshold_;
+  uint32_t width_, height_, bytes_per_pixel_;
+  uint32_t sequence_, frames_since_keyframe_;
+  bool force_keyframe_;
+
+  // the frame as reconstructed by the decoder
+  std::vector<uint8_t> reference_;
+
+  bool tileChanged(const uint8_t* data, uint32_t step, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint32_t bytes_per_sample) const;
+};
+
+class TileDeltaDecoder
+{
+public:
+  enum Result
+  {
+    FRAME_DECODED,
+    WAITING_FOR_KEYFRAME,
+    CORRUPT_DATA
+  };
+
+  TileDeltaDecoder();
+
+  Result decode(const uint8_t* input, size_t size);
+
+  /**
+   * Packed frame of height() rows with width() * bytesPerPixel() bytes, valid after FRAME_DECODED.
+   */
+  const std::vector<uint8_t>& frame() const { return frame_; }
+
+  uint32_t width() const { return width_; }
+  uint32_t height() const { return height_; }
+  uint32_t bytesPerPixel() const { return bytes_per_pixel_; }
+
+  /**
+   * Number of tiles updated by the last decoded frame.
+   */
+  uint32_t updatedTiles() const { return updated_tiles_; }
+private:
+  std::vector<uint8_t> frame_;
+  uint32_t width_, height_, bytes_per_pixel_, sequence_, updated_tiles_;
+  bool synchronized_;
+};
+
+} /* namespace openni2_camera */
+#endif /* TILE_DELTA_CODEC_H_ */
@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef TILE_DELTA_IMAGE_TRANSPORT_H_
+#define TILE_DELTA_IMAGE_TRANSPORT_H_
+
+#include <image_transport/simple_publisher_plugin.h>
+#include <image_transport/simple_subscriber_plugin.h>
+#include <sensor_msgs/CompressedImage.h>
+
+#include <openni2_camera/tile_delta_codec.h>
+
+#include <boost/thread/mutex.hpp>
+
+namespace openni2_camera
+{
+
+/**
+ * Publishes periodic keyframes and per tile deltas against the previous frame. The transport
+ * parameters tile_size, keyframe_interval (frames, 0 disables periodic keyframes) and threshold
+ * (maximum per sample difference of a tile considered unchanged) are read from the transport
+ * namespace, e.g. depth/image_raw/tile_delta/tile_size.
+ */
+class TileDeltaPublisher : public image_transport::SimplePublisherPlugin<sensor_msgs::CompressedImage>
+{
+public:
+  virtual ~TileDeltaPublisher() {}
+
+  virtual std::string getTransportName() const
+  {
+    return "tile_delta";
+  }
+protected:
+  mutable boost::mutex encoder_mutex_;
+  mutable TileDeltaEncoder encoder_;
+
+  virtual void publish(const sensor_msgs::Image& message, const PublishFn& publish_fn) const;
+
+  virtual void connectCallback(const ros::SingleSubscriberPublisher& pub);
+};
+
+class TileDeltaSubscriber : public image_transport::SimpleSubscriberPlugin<sensor_msgs::CompressedImage>
+{
+public:
+  virtual ~TileDeltaSubscriber() {}
+
+  virtual std::string getTransportName() const
+  {
+    return "tile_delta";
+  }
+protected:
+  TileDeltaDecoder decoder_;
+
+  virtual void internalCallback(const sensor_msgs::CompressedImageConstPtr& message, const Callback& user_cb);
+};
+
+} /* namespace openni2_camera */
+#endif /* TILE_DELTA_IMAGE_TRANSPORT_H_ */
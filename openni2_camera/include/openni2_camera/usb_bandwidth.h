@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef USB_BANDWIDTH_H_
+#define USB_BANDWIDTH_H_
+
+#include <openni2/OpenNI.h>
+
+#include <boost/thread/mutex.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace openni2_camera
+{
+
+/**
+ * Estimated bytes per second a stream needs on the wire with the given PS1080 input format.
+ * Compressed formats use average ratios, the actual rate depends on the scene.
+ */
+double estimateBandwidth(openni::SensorType type, const openni::VideoMode& mode, int input_format);
+
+/**
+ * PS1080 input formats of the sensor type ordered by increasing compression, starting with
+ * current_format. Only formats which compress more than current_format, can produce the pixel
+ * format of mode and are accepted by the firmware at its resolution are included.
+ */
+std::vector<int> inputFormatCandidates(openni::SensorType type, const openni::VideoMode& mode, int current_format);
+
+std::string inputFormatName(openni::SensorType type, int input_format);
+
+struct BandwidthOption
+{
+  openni::VideoMode mode;
+  int input_format;
+  double bandwidth;
+};
+
+/**
+ * Assigns each running stream a share of its USB bus. Streams are admitted before they start
+ * with their options in order of preference, the first option which fits into what the other
+ * streams on the bus leave is chosen. Shared by all cameras of the process.
+ */
+class UsbBandwidthPlanner
+{
+public:
+  static UsbBandwidthPlanner& instance();
+
+  /**
+   * Usable bytes per second per bus, 0 disables planning. The budget is shared by all buses and
+   * cameras, the first one set is kept and different ones set later are ignored with a warning.
+   */
+  void setBudget(double budget);
+  double budget() const;
+
+  /**
+   * Replaces a previous allocation of stream_id. Returns false and keeps nothing allocated if no
+   * option fits, in that case chosen is untouched.
+   */
+  bool admit(unsigned bus, const std::string& stream_id, openni::SensorType type, const std::vector<BandwidthOption>& options, size_t& chosen);
+
+  void release(const std::string& stream_id);
+private:
+  struct Allocation
+  {
+    unsigned bus;
+    double bandwidth;
+    std::string description;
+  };
+
+  UsbBandwidthPlanner();
+
+  mutable boost::mutex mutex_;
+  double budget_;
+  bool budget_set_;
+  std::map<std::string, Allocation> allocations_;
+
+  double allocated(unsigned bus) const;
+  void report(unsigned bus) const;
+};
+
+} /* namespace openni2_camera */
+#endif /* USB_BANDWIDTH_H_ */
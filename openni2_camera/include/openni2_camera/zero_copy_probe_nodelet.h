@@ -0,0 +1,68 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ZERO_COPY_PROBE_NODELET_H_
+#define ZERO_COPY_PROBE_NODELET_H_
+
+#include <nodelet/nodelet.h>
+#include <image_transport/image_transport.h>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace openni2_camera
+{
+
+/**
+ * Verifies intra-process delivery. Loaded into the driver's nodelet manager it subscribes to
+ * "image" with the raw transport and counts the messages which are the driver's own buffer and
+ * those which arrived as a copy, e.g. because of a transport plugin or a remap to another process.
+ *
+ * The counts are logged and published latched on ~report as a ZeroCopyReport every
+ * ~report_interval seconds (default 5). With ~require_zero_copy (default true) every copy is
+ * reported as an error.
+ */
+class ZeroCopyProbeNodelet : public nodelet::Nodelet
+{
+private:
+  boost::scoped_ptr<image_transport::ImageTransport> it_;
+  image_transport::Subscriber subscriber_;
+  ros::WallTimer report_timer_;
+  ros::Publisher report_publisher_;
+  bool require_zero_copy_;
+
+  boost::mutex mutex_;
+  uint64_t received_, zero_copy_, copied_;
+
+  void onImage(const sensor_msgs::ImageConstPtr& image);
+
+  void onReport(const ros::WallTimerEvent& event);
+public:
+  ZeroCopyProbeNodelet();
+  virtual ~ZeroCopyProbeNodelet();
+
+  virtual void onInit();
+};
+
+} /* namespace openni2_camera */
+#endif /* ZERO_COPY_PROBE_NODELET_H_ */
@@ -23,13 +23,48 @@
 
 #include <openni2_camera/camera.h>
 #include <openni2_camera/CameraConfig.h>
+#include <openni2_camera/FrameStatistics.h>
+#include <openni2_camera/StreamMetrics.h>
+#include <openni2_camera/frame_statistics.h>
+#include <openni2_camera/frame_poller.h>
+#include <openni2_camera/frame_worker.h>
+#include <openni2_camera/published_image_registry.h>
+#include <openni2_camera/shm_image_ring.h>
+#include <openni2_camera/ShmImageNotification.h>
+#include <openni2_camera/StartRecording.h>
+#include <openni2_camera/SetPlayback.h>
+#include <openni2_camera/SeekPlayback.h>
+#include <openni2_camera/DeviceClock.h>
+#include <openni2_camera/device_clock.h>
+#include <openni2_camera/device_index.h>
+#include <openni2_camera/device_profile.h>
+#include <openni2_camera/frame_log_queue.h>
+#include <openni2_camera/pre_trigger_ring.h>
+#include <openni2_camera/DumpFrames.h>
+#include <openni2_camera/usb_bandwidth.h>
+
+#include <openni2/PS1080.h>
 
 #include <image_transport/image_transport.h>
 #include <camera_info_manager/camera_info_manager.h>
 #include <sensor_msgs/image_encodings.h>
 #include <dynamic_reconfigure/server.h>
+#include <std_msgs/Header.h>
+#include <std_srvs/Empty.h>
 
+#include <boost/algorithm/string/replace.hpp>
 #include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/optional.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
 
 namespace openni2_camera
 {
@@ -39,6 +74,9 @@ namespace internal
 
 using namespace openni;
 
+// OpenNI's playback speed for replaying without waiting for the recorded timestamps
+static const float PLAYBACK_SPEED_FASTEST = -1.0f;
+
 int findVideoMode(const Array<VideoMode>& modes, int x, int y, PixelFormat format, int fps = 30)
 {
   int result = 0;
@@ -83,6 +121,11 @@ std::string toString(const PixelFormat& format)
   }
 }
 
+bool isSameVideoMode(const VideoMode& a, const VideoMode& b)
+{
+  return a.getResolutionX() == b.getResolutionX() && a.getResolutionY() == b.getResolutionY() && a.getPixelFormat() == b.getPixelFormat() && a.getFps() == b.getFps();
+}
+
 std::string toString(const SensorType& type)
 {
   switch(type)
@@ -98,6 +141,27 @@ std::string toString(const SensorType& type)
   }
 }
 
+std::string toEncoding(const PixelFormat& format)
+{
+  switch(format)
+  {
+  case PIXEL_FORMAT_GRAY8:
+    return sensor_msgs::image_encodings::MONO8;
+  case PIXEL_FORMAT_GRAY16:
+    return sensor_msgs::image_encodings::MONO16;
+  case PIXEL_FORMAT_YUV422:
+    return sensor_msgs::image_encodings::YUV422;
+  case PIXEL_FORMAT_RGB888:
+    return sensor_msgs::image_encodings::RGB8;
+  case PIXEL_FORMAT_SHIFT_9_2:
+  case PIXEL_FORMAT_DEPTH_1_MM:
+    return sensor_msgs::image_encodings::TYPE_16UC1;
+  default:
+    ROS_WARN("Unknown OpenNI pixel format!");
+    return std::string();
+  }
+}
+
 class MethodNotSupportedException : std::exception
 {
 private:
@@ -115,98 +179,586 @@ public:
   }
 };
 
+enum StreamState
+{
+  STREAM_STOPPED,
+  STREAM_RUNNING,
+  STREAM_CONFIGURING
+};
+
+/**
+ * Limits the published frames which the benchmark did not acknowledge yet, so a recording is
+ * replayed as fast as the processing pipeline keeps up. An acknowledgement covers all frames
+ * stamped at or before it. Waiting in the frame path stops reading frames, so with
+ * acquisition_mode polling and without processing threads it holds back the player.
+ */
+class BenchmarkGate
+{
+private:
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+  std::deque<ros::Time> in_flight_;
+  size_t window_;
+  ros::WallDuration timeout_;
+  bool stopped_;
+
+public:
+  BenchmarkGate(size_t window, const ros::WallDuration& timeout) :
+    window_(std::max<size_t>(window, 1)),
+    timeout_(timeout),
+    stopped_(false)
+  {
+  }
+
+  void enter(const ros::Time& ts)
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+
+    ros::WallTime deadline = ros::WallTime::now() + timeout_;
+
+    while(!stopped_ && in_flight_.size() >= window_)
+    {
+      ros::WallDuration remaining = deadline - ros::WallTime::now();
+
+      if(remaining <= ros::WallDuration(0.0))
+      {
+        // the pipeline dropped the frame or the benchmark is gone, do not wait forever
+        ROS_WARN_THROTTLE(1.0, "No benchmark acknowledgement within %.2f s, releasing a frame.", timeout_.toSec());
+        in_flight_.pop_front();
+        break;
+      }
+
+      condition_.timed_wait(lock, boost::posix_time::microseconds(int64_t(remaining.toSec() * 1e6)));
+    }
+
+    in_flight_.push_back(ts);
+  }
+
+  void acknowledge(const std_msgs::HeaderConstPtr& ack)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    std::deque<ros::Time>::iterator end = std::remove_if(in_flight_.begin(), in_flight_.end(), boost::bind(std::less_equal<ros::Time>(), _1, ack->stamp));
+    in_flight_.erase(end, in_flight_.end());
+
+    condition_.notify_all();
+  }
+
+  /**
+   * Releases waiting frames for good, e.g. before the streams are stopped.
+   */
+  void stop()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    stopped_ = true;
+    condition_.notify_all();
+  }
+};
+
+/**
+ * Immutable snapshot of everything the frame path needs. The control plane publishes a new one on
+ * every change, frame callbacks always see a complete configuration without taking a lock.
+ */
+struct StreamConfig
+{
+  typedef boost::shared_ptr<const StreamConfig> ConstPtr;
+
+  StreamState state;
+  std::string frame_id;
+  image_transport::CameraPublisher* publisher;
+  int data_skip;
+  double period;
+
+  // when the stream was last stopped for a reconfiguration which it has resumed from
+  ros::WallTime resume_start;
+
+  // when the last subscription after a period without subscribers was requested, and whether the
+  // stream was still running then
+  ros::WallTime subscribe_time;
+  bool subscribe_warm;
+
+  // when the device was lost before the last reconnect of a subscribed stream
+  ros::WallTime reconnect_start;
+
+  // processed frames are appended to it, or kept in it, if set
+  boost::shared_ptr<FrameLogQueue> frame_log;
+  boost::shared_ptr<PreTriggerRing> pre_trigger_ring;
+
+  // published frames pass it in benchmark mode
+  boost::shared_ptr<BenchmarkGate> benchmark_gate;
+
+  StreamConfig() :
+    state(STREAM_STOPPED),
+    publisher(0),
+    data_skip(0),
+    period(0.0),
+    subscribe_warm(false)
+  {
+  }
+};
+
+/**
+ * Decides which frames of a stream are processed, based on the skip count and minimum period of
+ * the current configuration. Only used from the frame delivery thread.
+ */
+class FrameThrottle
+{
+private:
+  int data_skip_;
+  double period_;
+  uint64_t counter_;
+  ros::Time next_;
+public:
+  FrameThrottle() :
+    data_skip_(0),
+    period_(0.0),
+    counter_(0)
+  {
+  }
+
+  bool accept(const StreamConfig& config, const ros::Time& now)
+  {
+    if(config.data_skip != data_skip_ || config.period != period_)
+    {
+      data_skip_ = config.data_skip;
+      period_ = config.period;
+      counter_ = 0;
+      next_ = ros::Time();
+    }
+
+    if(data_skip_ > 0 && (counter_++ % (data_skip_ + 1)) != 0) return false;
+
+    if(period_ > 0.0)
+    {
+      // a quarter period of slack absorbs the arrival jitter, advancing the deadline by whole
+      // periods keeps the average rate at the maximum
+      ros::Duration period(period_);
+
+      if(!next_.isZero() && now + period * 0.25 < next_) return false;
+
+      next_ = (next_.isZero() || next_ + period < now ? now : next_) + period;
+    }
+
+    return true;
+  }
+};
+
 class SensorStreamManagerBase
 {
 public:
   SensorStreamManagerBase() {}
   virtual ~SensorStreamManagerBase() {}
 
-  virtual VideoStream& stream()
+  /**
+   * Returns the mode the stream is configured with afterwards, the previous one if mode was
+   * rejected.
+   */
+  virtual VideoMode configureVideoMode(const VideoMode& mode)
+  {
+    return mode;
+  }
+
+  virtual void configureMirroring(bool enabled)
+  {
+  }
+
+  virtual void configureAutoExposure(bool enabled)
+  {
+  }
+
+  virtual void configureAutoWhiteBalance(bool enabled)
+  {
+  }
+
+  virtual bool configureRegistration(bool enabled)
+  {
+    return false;
+  }
+
+  virtual void configureThrottle(int data_skip, double max_rate)
   {
-    throw MethodNotSupportedException("SensorStreamManagerBase::stream()");
   }
 
-  virtual bool beginConfigure()
+  virtual void configureLingerTime(double linger_time)
+  {
+  }
+
+  /**
+   * Starts acting on subscriptions, called once the manager is fully constructed.
+   */
+  virtual void start()
+  {
+  }
+
+  virtual void disconnect()
+  {
+  }
+
+  virtual void reconnect(const ros::WallTime& disconnect_time)
+  {
+  }
+
+  virtual bool attachRecorder(Recorder& recorder, bool allow_lossy_compression, bool start)
+  {
+    return false;
+  }
+
+  virtual void detachRecorder()
+  {
+  }
+
+  virtual bool seek(PlaybackControl& playback, int frame, int& number_of_frames)
   {
     return false;
   }
 
-  virtual bool tryConfigureVideoMode(VideoMode& mode)
+  virtual void setFrameLog(const boost::shared_ptr<FrameLogQueue>& frame_log)
+  {
+  }
+
+  virtual void setPreTriggerRing(const boost::shared_ptr<PreTriggerRing>& ring)
   {
-    throw MethodNotSupportedException("SensorStreamManagerBase::tryConfigureVideoMode()");
   }
 
-  virtual void endConfigure()
+  virtual void setBenchmarkGate(const boost::shared_ptr<BenchmarkGate>& gate)
   {
-    throw MethodNotSupportedException("SensorStreamManagerBase::endConfigure()");
   }
 };
 
+/**
+ * Stream start, stop and reconfiguration are serialized by control_mutex_. The frame path never
+ * takes it, it works on the snapshot loaded at the start of each frame. Subscription changes only
+ * signal control_thread_, which starts and stops the stream, so ROS callbacks never wait for USB.
+ *
+ * The VideoStream is created on the first subscription, settings configured before are kept and
+ * applied on creation. Frames are delivered by OpenNI's listener callback, or by the FramePoller
+ * while the stream is running if one is given.
+ *
+ * If the device is lost the stream is destroyed but the publishers stay, after the device was
+ * reopened the stream is recreated with the same settings and restarted if it has subscribers.
+ */
 class SensorStreamManager : public SensorStreamManagerBase, public VideoStream::NewFrameListener
 {
 protected:
   Device& device_;
+  SensorType type_;
   VideoStream stream_;
-  VideoMode default_mode_;
+  VideoMode video_mode_;
   std::string name_, frame_id_;
-  bool running_, was_running_;
+  ros::WallTime startup_time_;
+  FramePoller* poller_;
 
-  ros::NodeHandle nh_;
+  boost::mutex control_mutex_;
+  StreamState state_;
+  bool running_, was_running_;
+  int data_skip_;
+  double period_;
+  bool mirror_;
+  boost::optional<bool> auto_exposure_, auto_white_balance_;
+  ros::WallTime configure_start_, resume_start_;
+  double linger_time_;
+  bool subscribed_, subscribe_warm_;
+  ros::WallTime subscribe_time_, linger_deadline_;
+  bool connected_, recording_;
+  boost::shared_ptr<FrameLogQueue> frame_log_;
+  boost::shared_ptr<PreTriggerRing> pre_trigger_ring_;
+  boost::shared_ptr<BenchmarkGate> benchmark_gate_;
+  ros::WallTime reconnect_start_;
+  std::string stream_id_;
+  bool allow_lower_modes_;
+  int default_input_format_;
+
+  boost::shared_ptr<DeviceClockEstimator> clock_;
+  bool use_device_timestamps_, frameset_images_;
+  boost::shared_ptr<FrameHistory> frame_history_;
+  StreamConfig::ConstPtr config_;
+
+  boost::mutex request_mutex_;
+  boost::condition_variable request_condition_;
+  bool update_requested_, shutdown_requested_;
+  ros::WallTime request_time_;
+  boost::thread control_thread_;
+
+  ros::NodeHandle nh_, nh_private_;
   image_transport::ImageTransport it_;
   camera_info_manager::CameraInfoManager camera_info_manager_;
   image_transport::CameraPublisher publisher_;
   image_transport::SubscriberStatusCallback callback_;
 
+  ros::Publisher statistics_publisher_;
+  FrameStatisticsCollector statistics_collector_;
+
+  ros::Publisher shm_publisher_;
+  ShmImageRingWriter shm_writer_;
+
+  // owned by the frame delivery thread
+  ros::Publisher metrics_publisher_;
+  StreamMetrics metrics_;
+  ros::WallTime handled_resume_start_, handled_subscribe_time_, handled_reconnect_start_;
+  bool first_frame_;
+  int last_delivered_index_;
+
+  // owned by the thread which processes frames
+  int last_frame_index_;
+
+  boost::scoped_ptr<FrameWorker> worker_;
+  FrameThrottle throttle_;
 
-  virtual void publish(sensor_msgs::Image::Ptr& image, sensor_msgs::CameraInfo::Ptr& camera_info)
+  size_t numAuxiliarySubscribers()
   {
-    publisher_.publish(image, camera_info);
+    return statistics_publisher_.getNumSubscribers() + shm_publisher_.getNumSubscribers();
   }
-public:
-  SensorStreamManager(ros::NodeHandle& nh, Device& device, SensorType type, std::string name, std::string frame_id, VideoMode& default_mode) :
-    device_(device),
-    default_mode_(default_mode),
-    name_(name),
-    frame_id_(frame_id),
-    running_(false),
-    nh_(nh, name_),
-    it_(nh_),
-    camera_info_manager_(nh_)
+
+  virtual size_t numSubscribers()
   {
-    assert(device_.hasSensor(type));
+    return publisher_.getNumSubscribers() + numAuxiliarySubscribers();
+  }
 
-    callback_ = boost::bind(&SensorStreamManager::onSubscriptionChanged, this, _1);
-    publisher_ = it_.advertiseCamera("image_raw", 1, callback_, callback_);
+  /**
+   * Fills in the stream specific part of a new snapshot, called with control_mutex_ held.
+   */
+  virtual void buildConfig(StreamConfig& config)
+  {
+    config.frame_id = frame_id_;
+    config.publisher = &publisher_;
+  }
 
-    ROS_ERROR_STREAM_COND(stream_.create(device_, type) != STATUS_OK, "Failed to create stream '" << toString(type) << "'!");
-    stream_.addNewFrameListener(this);
-    ROS_ERROR_STREAM_COND(stream_.setVideoMode(default_mode_) != STATUS_OK, "Failed to set default video mode for stream '" << toString(type) << "'!");
+  void publishConfig(StreamState state)
+  {
+    boost::shared_ptr<StreamConfig> config(new StreamConfig);
+    config->state = state;
+    config->data_skip = data_skip_;
+    config->period = period_;
+    config->resume_start = resume_start_;
+    config->subscribe_time = subscribe_time_;
+    config->subscribe_warm = subscribe_warm_;
+    config->reconnect_start = reconnect_start_;
+    config->frame_log = frame_log_;
+    config->pre_trigger_ring = pre_trigger_ring_;
+    config->benchmark_gate = benchmark_gate_;
+    buildConfig(*config);
+
+    state_ = state;
+    boost::atomic_store(&config_, StreamConfig::ConstPtr(config));
   }
 
-  virtual ~SensorStreamManager()
+  StreamConfig::ConstPtr loadConfig() const
   {
-    stream_.removeNewFrameListener(this);
-    stream_.stop();
+    return boost::atomic_load(&config_);
+  }
+
+  /**
+   * Creates the stream on first use and applies the settings configured so far, called with
+   * control_mutex_ held.
+   */
+  bool createStream()
+  {
+    if(stream_.isValid()) return true;
+
+    ros::WallTime begin = ros::WallTime::now();
+
+    if(stream_.create(device_, type_) != STATUS_OK)
+    {
+      ROS_ERROR_STREAM("Failed to create stream '" << toString(type_) << "'!");
+      return false;
+    }
+
+    if(poller_ == 0) stream_.addNewFrameListener(this);
+    ROS_ERROR_STREAM_COND(stream_.setVideoMode(video_mode_) != STATUS_OK, "Failed to set video mode for stream '" << toString(type_) << "'!");
+    ROS_ERROR_STREAM_COND(mirror_ && stream_.setMirroringEnabled(true) != STATUS_OK, "Failed to set mirroring for stream '" << name_ << "'!");
+    applyCameraSettings();
+
+    statistics_collector_.setSaturationValue(uint16_t(std::max(stream_.getMaxPixelValue(), 1)));
+
+    ROS_INFO_STREAM("Created stream '" << name_ << "' in " << (ros::WallTime::now() - begin).toSec() * 1000.0 << " ms.");
+
+    return true;
+  }
+
+  void destroyStream()
+  {
+    if(!stream_.isValid()) return;
+
+    if(poller_ == 0) stream_.removeNewFrameListener(this);
     stream_.destroy();
+  }
 
-    publisher_.shutdown();
+  void addToPoller()
+  {
+    if(poller_ != 0) poller_->add(stream_, boost::bind(&SensorStreamManager::dispatchFrame, this, _1, _2));
+  }
+
+  void removeFromPoller()
+  {
+    if(poller_ != 0) poller_->remove(stream_);
+  }
+
+  void applyCameraSettings()
+  {
+    CameraSettings* settings = stream_.getCameraSettings();
+
+    if(settings == 0 || !settings->isValid()) return;
+
+    if(auto_exposure_ && settings->getAutoExposureEnabled() != *auto_exposure_)
+    {
+      ROS_ERROR_STREAM_COND(settings->setAutoExposureEnabled(*auto_exposure_) != STATUS_OK, "Failed to set auto exposure for stream '" << name_ << "'!");
+    }
+
+    if(auto_white_balance_ && settings->getAutoWhiteBalanceEnabled() != *auto_white_balance_)
+    {
+      ROS_ERROR_STREAM_COND(settings->setAutoWhiteBalanceEnabled(*auto_white_balance_) != STATUS_OK, "Failed to set auto white balance for stream '" << name_ << "'!");
+    }
+  }
+
+  /**
+   * Finds lower video modes of the same pixel format, ordered by decreasing data rate.
+   */
+  void appendLowerModes(const VideoMode& mode, std::vector<VideoMode>& modes)
+  {
+    const SensorInfo* info = device_.getSensorInfo(type_);
+
+    if(info == 0) return;
+
+    const Array<VideoMode>& supported = info->getSupportedVideoModes();
+    size_t begin = modes.size();
+    double rate = double(mode.getResolutionX()) * mode.getResolutionY() * mode.getFps();
+
+    for(int idx = 0; idx < supported.getSize(); ++idx)
+    {
+      const VideoMode& candidate = supported[idx];
+      double candidate_rate = double(candidate.getResolutionX()) * candidate.getResolutionY() * candidate.getFps();
+
+      if(candidate.getPixelFormat() != mode.getPixelFormat() || candidate.getFps() > mode.getFps() || candidate_rate >= rate) continue;
+
+      std::vector<VideoMode>::iterator position = modes.begin() + begin;
+
+      while(position != modes.end() && double(position->getResolutionX()) * position->getResolutionY() * position->getFps() >= candidate_rate) ++position;
+
+      modes.insert(position, candidate);
+    }
+  }
+
+  /**
+   * Reserves USB bandwidth for running the stream in mode, preferring the default input format,
+   * then more compressed ones and finally lower modes. Applies the input format and returns the
+   * mode to use in chosen_mode. Called with control_mutex_ held and the stream stopped.
+   */
+  bool admitBandwidth(const VideoMode& mode, VideoMode& chosen_mode)
+  {
+    chosen_mode = mode;
+
+    UsbLocation location;
+
+    if(!parseUsbUri(device_.getDeviceInfo().getUri(), location)) return true;
+
+    int current_format;
+
+    // only PS1080 devices have input formats
+    if(stream_.getProperty(XN_STREAM_PROPERTY_INPUT_FORMAT, &current_format) != STATUS_OK) return true;
+
+    if(default_input_format_ < 0) default_input_format_ = current_format;
+
+    std::vector<VideoMode> modes(1, mode);
+    if(allow_lower_modes_) appendLowerModes(mode, modes);
+
+    std::vector<BandwidthOption> options;
+
+    for(size_t midx = 0; midx < modes.size(); ++midx)
+    {
+      // lower modes may rule out formats, e.g. Bayer
+      std::vector<int> formats = inputFormatCandidates(type_, modes[midx], default_input_format_);
+
+      for(size_t fidx = 0; fidx < formats.size(); ++fidx)
+      {
+        BandwidthOption option;
+        option.mode = modes[midx];
+        option.input_format = formats[fidx];
+        option.bandwidth = estimateBandwidth(type_, modes[midx], formats[fidx]);
+        options.push_back(option);
+      }
+    }
+
+    size_t chosen;
+
+    if(!UsbBandwidthPlanner::instance().admit(location.bus, stream_id_, type_, options, chosen)) return false;
+
+    const BandwidthOption& option = options[chosen];
+
+    if(option.input_format != current_format)
+    {
+      ROS_INFO_STREAM("Using input format " << inputFormatName(type_, option.input_format) << " for stream '" << name_ << "'.");
+      ROS_ERROR_STREAM_COND(stream_.setProperty(XN_STREAM_PROPERTY_INPUT_FORMAT, option.input_format) != STATUS_OK, "Failed to set input format for stream '" << name_ << "'!");
+    }
+
+    if(!isSameVideoMode(option.mode, mode))
+    {
+      ROS_WARN_STREAM("Lowering stream '" << name_ << "' to " << option.mode.getResolutionX() << "x" << option.mode.getResolutionY() << "@" << option.mode.getFps() << " to fit into the USB bandwidth.");
+    }
+
+    chosen_mode = option.mode;
+
+    return true;
+  }
+
+  bool startStream()
+  {
+    if(!createStream()) return false;
+
+    VideoMode mode;
+
+    if(!admitBandwidth(video_mode_, mode))
+    {
+      ROS_ERROR_STREAM("Not starting stream '" << name_ << "', it does not fit into the USB bandwidth!");
+      return false;
+    }
+
+    if(!isSameVideoMode(stream_.getVideoMode(), mode))
+    {
+      ROS_ERROR_STREAM_COND(stream_.setVideoMode(mode) != STATUS_OK, "Failed to set video mode for stream '" << name_ << "'!");
+    }
+
+    // publish first, so the first frame is not dropped
+    publishConfig(STREAM_RUNNING);
+    running_ = (stream_.start() == STATUS_OK);
+
+    if(running_)
+    {
+      addToPoller();
+    }
+    else
+    {
+      publishConfig(STREAM_STOPPED);
+      UsbBandwidthPlanner::instance().release(stream_id_);
+    }
+
+    return running_;
   }
 
-  virtual VideoStream& stream()
+  void stopStream()
   {
-    return stream_;
+    publishConfig(STREAM_STOPPED);
+    removeFromPoller();
+    stream_.stop();
+    running_ = false;
+    UsbBandwidthPlanner::instance().release(stream_id_);
   }
 
-  virtual bool beginConfigure()
+  /**
+   * Stops the stream for a change which cannot be applied while streaming, called with
+   * control_mutex_ held.
+   */
+  void beginConfigure()
   {
     was_running_ = running_;
+    publishConfig(STREAM_CONFIGURING);
+    configure_start_ = ros::WallTime::now();
+    removeFromPoller();
     if(was_running_) stream_.stop();
     running_ = false;
-
-    return true;
   }
 
-  virtual void endConfigure()
+  void endConfigure()
   {
     if(was_running_)
     {
@@ -214,21 +766,32 @@ public:
 
       if(rc != STATUS_OK)
       {
-        SensorType type = stream_.getSensorInfo().getSensorType();
         ROS_WARN_STREAM("Failed to restart stream '" << name_ << "' after configuration!");
 
+        // a recreated stream starts with the configured mode and the default input format, keep
+        // the ones chosen by admitBandwidth
+        VideoMode admitted_mode = stream_.getVideoMode();
+        int input_format;
+        bool has_input_format = stream_.getProperty(XN_STREAM_PROPERTY_INPUT_FORMAT, &input_format) == STATUS_OK;
+
         int max_trials = 1;
 
         for(int trials = 0; trials < max_trials && rc != STATUS_OK; ++trials)
         {
           ros::Duration(0.1).sleep();
 
-          stream_.removeNewFrameListener(this);
-          stream_.destroy();
-          stream_.create(device_, type);
-          stream_.addNewFrameListener(this);
-          //stream_.setVideoMode(default_mode_);
-          rc = stream_.start();
+          destroyStream();
+
+          if(createStream())
+          {
+            ROS_ERROR_STREAM_COND(has_input_format && stream_.setProperty(XN_STREAM_PROPERTY_INPUT_FORMAT, input_format) != STATUS_OK, "Failed to set input format for stream '" << name_ << "'!");
+            ROS_ERROR_STREAM_COND(!isSameVideoMode(stream_.getVideoMode(), admitted_mode) && stream_.setVideoMode(admitted_mode) != STATUS_OK, "Failed to set video mode for stream '" << name_ << "'!");
+            rc = stream_.start();
+          }
+          else
+          {
+            rc = STATUS_ERROR;
+          }
 
           ROS_WARN_STREAM_COND(rc != STATUS_OK, "Recovery trial " << trials << " failed!");
         }
@@ -239,295 +802,1626 @@ public:
 
       if(rc == STATUS_OK)
       {
-        running_ = true;
+        running_ = true;
+        resume_start_ = configure_start_;
+        addToPoller();
+      }
+    }
+
+    if(!running_) UsbBandwidthPlanner::instance().release(stream_id_);
+
+    publishConfig(running_ ? STREAM_RUNNING : STREAM_STOPPED);
+  }
+
+  bool tryConfigureVideoMode(const VideoMode& mode)
+  {
+    bool result = true;
+    VideoMode old = stream_.getVideoMode();
+
+    if(stream_.setVideoMode(mode) != STATUS_OK)
+    {
+      ROS_ERROR_STREAM_COND(stream_.setVideoMode(old) != STATUS_OK, "Failed to recover old video mode!");
+      result = false;
+    }
+    else
+    {
+      video_mode_ = mode;
+    }
+
+    return result;
+  }
+public:
+  SensorStreamManager(ros::NodeHandle& nh, ros::NodeHandle& nh_private, Device& device, SensorType type, std::string name, std::string frame_id, VideoMode& default_mode, const ros::WallTime& startup_time, FramePoller* poller, const boost::shared_ptr<FrameWorkerPool>& pool, const boost::shared_ptr<DeviceClockEstimator>& clock) :
+    device_(device),
+    type_(type),
+    video_mode_(default_mode),
+    name_(name),
+    frame_id_(frame_id),
+    startup_time_(startup_time),
+    poller_(poller),
+    state_(STREAM_STOPPED),
+    running_(false),
+    was_running_(false),
+    data_skip_(0),
+    period_(0.0),
+    mirror_(false),
+    linger_time_(0.0),
+    subscribed_(false),
+    subscribe_warm_(false),
+    connected_(true),
+    recording_(false),
+    allow_lower_modes_(true),
+    default_input_format_(-1),
+    clock_(clock),
+    config_(new StreamConfig),
+    update_requested_(false),
+    shutdown_requested_(false),
+    nh_(nh, name_),
+    nh_private_(nh_private),
+    it_(nh_),
+    camera_info_manager_(nh_),
+    first_frame_(true),
+    last_delivered_index_(-1),
+    last_frame_index_(-1)
+  {
+    // the device may not be open yet, see CameraImpl
+    assert(!device_.isValid() || device_.hasSensor(type));
+
+    stream_id_ = nh_.getNamespace();
+    nh_private_.param("usb_allow_lower_modes", allow_lower_modes_, true);
+    nh_private_.param("use_device_timestamps", use_device_timestamps_, false);
+    // recordings are stamped from their recorded timestamps, except for benchmarks, which measure
+    // latencies from the arrival
+    bool benchmark;
+    nh_private_.param("benchmark", benchmark, false);
+    use_device_timestamps_ = use_device_timestamps_ || (device_.isFile() && !benchmark);
+    int frameset_history;
+    nh_private_.param("frameset_history", frameset_history, 0);
+    nh_private_.param("frameset_images", frameset_images_, false);
+
+    if(frameset_history > 0)
+    {
+      frame_history_.reset(new FrameHistory(size_t(frameset_history)));
+      MultiDeviceClock::instance().addStream(stream_id_, frame_history_);
+    }
+
+    callback_ = boost::bind(&SensorStreamManager::onSubscriptionChanged, this, _1);
+    publisher_ = it_.advertiseCamera("image_raw", 1, callback_, callback_);
+
+    ros::SubscriberStatusCallback auxiliary_callback = boost::bind(&SensorStreamManager::onAuxiliarySubscriptionChanged, this, _1);
+    statistics_publisher_ = nh_.advertise<FrameStatistics>("frame_stats", 1, auxiliary_callback, auxiliary_callback);
+    metrics_publisher_ = nh_.advertise<StreamMetrics>("metrics", 1, true);
+
+    int histogram_bins;
+    double histogram_max;
+    nh_private_.param(name_ + "_histogram_bins", histogram_bins, 16);
+    nh_private_.param(name_ + "_histogram_max", histogram_max, 8000.0);
+    statistics_collector_.setHistogram(uint32_t(std::max(histogram_bins, 1)), float(histogram_max));
+
+    int shm_slots, shm_slot_size;
+    nh_private_.param(name_ + "_shm_slots", shm_slots, 0);
+    nh_private_.param(name_ + "_shm_slot_size", shm_slot_size, 1280 * 1024 * 3);
+
+    if(shm_slots > 0)
+    {
+      std::string default_segment = "/openni2" + boost::replace_all_copy(nh_.getNamespace(), "/", "_");
+      std::string segment;
+      nh_private_.param(name_ + "_shm_segment", segment, default_segment);
+
+      if(shm_writer_.create(segment, uint32_t(shm_slots), size_t(std::max(shm_slot_size, 1))))
+      {
+        shm_publisher_ = nh_.advertise<ShmImageNotification>("image_shm", 1, auxiliary_callback, auxiliary_callback);
+        ROS_INFO_STREAM("Publishing stream '" << name_ << "' to shared memory segment '" << segment << "' with " << shm_slots << " slots.");
+      }
+    }
+
+    bool processing_thread;
+    nh_private_.param(name_ + "_processing_thread", processing_thread, false);
+
+    if(processing_thread)
+    {
+      worker_.reset(new FrameWorker(ThreadOptions::fromParameters(nh_private_, name_, "openni2_" + name_), boost::bind(&SensorStreamManager::processFrame, this, _1, _2, _3)));
+    }
+    else if(pool)
+    {
+      worker_.reset(new FrameWorker(pool, boost::bind(&SensorStreamManager::processFrame, this, _1, _2, _3)));
+    }
+  }
+
+  virtual ~SensorStreamManager()
+  {
+    detachFrameProcessing();
+    destroyStream();
+
+    publisher_.shutdown();
+    statistics_publisher_.shutdown();
+    shm_publisher_.shutdown();
+    metrics_publisher_.shutdown();
+
+    if(frame_history_) MultiDeviceClock::instance().removeStream(stream_id_, frame_history_);
+  }
+
+  /**
+   * The control thread calls virtual methods, so it must not run before derived classes are
+   * constructed. Subscriptions made before are handled when it starts.
+   */
+  virtual void start()
+  {
+    if(!control_thread_.joinable()) control_thread_ = boost::thread(&SensorStreamManager::controlLoop, this);
+  }
+
+  virtual VideoMode configureVideoMode(const VideoMode& mode)
+  {
+    boost::mutex::scoped_lock lock(control_mutex_);
+
+    if(isSameVideoMode(video_mode_, mode)) return video_mode_;
+
+    if(!stream_.isValid())
+    {
+      video_mode_ = mode;
+      publishConfig(state_);
+      return video_mode_;
+    }
+
+    beginConfigure();
+
+    VideoMode chosen_mode = mode;
+
+    if(was_running_ && !admitBandwidth(mode, chosen_mode))
+    {
+      ROS_ERROR_STREAM("Rejecting video mode for stream '" << name_ << "', it does not fit into the USB bandwidth!");
+
+      // the old mode fitted before, but another stream may have taken the bandwidth it freed
+      VideoMode configured_mode = video_mode_;
+
+      if(admitBandwidth(configured_mode, chosen_mode))
+      {
+        tryConfigureVideoMode(chosen_mode);
+      }
+      else
+      {
+        ROS_ERROR_STREAM("Stream '" << name_ << "' lost its USB bandwidth to another stream, leaving it stopped!");
+        was_running_ = false;
+      }
+
+      video_mode_ = configured_mode;
+      endConfigure();
+      return video_mode_;
+    }
+
+    if(tryConfigureVideoMode(chosen_mode)) video_mode_ = mode;
+    endConfigure();
+
+    return video_mode_;
+  }
+
+  virtual void configureMirroring(bool enabled)
+  {
+    boost::mutex::scoped_lock lock(control_mutex_);
+
+    if(mirror_ == enabled) return;
+
+    mirror_ = enabled;
+
+    if(!stream_.isValid()) return;
+
+    // mirroring can usually be switched while streaming, restart only if the device refuses
+    if(stream_.setMirroringEnabled(enabled) == STATUS_OK) return;
+
+    beginConfigure();
+    ROS_ERROR_STREAM_COND(stream_.setMirroringEnabled(enabled) != STATUS_OK, "Failed to set mirroring for stream '" << name_ << "'!");
+    endConfigure();
+  }
+
+  virtual void configureAutoExposure(bool enabled)
+  {
+    boost::mutex::scoped_lock lock(control_mutex_);
+
+    auto_exposure_ = enabled;
+    if(stream_.isValid()) applyCameraSettings();
+  }
+
+  virtual void configureAutoWhiteBalance(bool enabled)
+  {
+    boost::mutex::scoped_lock lock(control_mutex_);
+
+    auto_white_balance_ = enabled;
+    if(stream_.isValid()) applyCameraSettings();
+  }
+
+  virtual void configureThrottle(int data_skip, double max_rate)
+  {
+    boost::mutex::scoped_lock lock(control_mutex_);
+
+    data_skip_ = std::max(data_skip, 0);
+    period_ = max_rate > 0.0 ? 1.0 / max_rate : 0.0;
+    publishConfig(state_);
+  }
+
+  virtual void configureLingerTime(double linger_time)
+  {
+    {
+      boost::mutex::scoped_lock lock(control_mutex_);
+
+      linger_time_ = std::max(linger_time, 0.0);
+      linger_deadline_ = ros::WallTime();
+    }
+
+    requestUpdate();
+  }
+
+  virtual void disconnect()
+  {
+    boost::mutex::scoped_lock lock(control_mutex_);
+
+    connected_ = false;
+
+    if(!stream_.isValid()) return;
+
+    if(running_) stopStream();
+    destroyStream();
+
+    ROS_WARN_STREAM("Stream '" << name_ << "' lost its device.");
+  }
+
+  virtual void reconnect(const ros::WallTime& disconnect_time)
+  {
+    {
+      boost::mutex::scoped_lock lock(control_mutex_);
+
+      connected_ = true;
+
+      // only a stream which is restarted right away has a meaningful reconnect latency
+      if(numSubscribers() > 0) reconnect_start_ = disconnect_time;
+    }
+
+    requestUpdate();
+  }
+
+  /**
+   * Adds the stream to the recording if it is running, or if start is set, starting it then.
+   */
+  virtual bool attachRecorder(Recorder& recorder, bool allow_lossy_compression, bool start)
+  {
+    {
+      boost::mutex::scoped_lock lock(control_mutex_);
+
+      if(!connected_ || (!running_ && !start) || !createStream()) return false;
+
+      if(recorder.attach(stream_, allow_lossy_compression) != STATUS_OK)
+      {
+        ROS_ERROR_STREAM("Failed to record stream '" << name_ << "': " << OpenNI::getExtendedError());
+        return false;
+      }
+
+      recording_ = true;
+    }
+
+    requestUpdate();
+
+    return true;
+  }
+
+  virtual void detachRecorder()
+  {
+    {
+      boost::mutex::scoped_lock lock(control_mutex_);
+
+      if(!recording_) return;
+
+      recording_ = false;
+    }
+
+    requestUpdate();
+  }
+
+  /**
+   * Appends the processed frames to the log while it is set, the stream keeps running without
+   * subscribers then.
+   */
+  virtual void setFrameLog(const boost::shared_ptr<FrameLogQueue>& frame_log)
+  {
+    {
+      boost::mutex::scoped_lock lock(control_mutex_);
+
+      frame_log_ = frame_log;
+      publishConfig(state_);
+    }
+
+    requestUpdate();
+  }
+
+  /**
+   * Keeps the processed frames in the ring while it is set, the stream keeps running without
+   * subscribers then.
+   */
+  virtual void setPreTriggerRing(const boost::shared_ptr<PreTriggerRing>& ring)
+  {
+    {
+      boost::mutex::scoped_lock lock(control_mutex_);
+
+      pre_trigger_ring_ = ring;
+      publishConfig(state_);
+    }
+
+    requestUpdate();
+  }
+
+  virtual void setBenchmarkGate(const boost::shared_ptr<BenchmarkGate>& gate)
+  {
+    boost::mutex::scoped_lock lock(control_mutex_);
+
+    benchmark_gate_ = gate;
+    publishConfig(state_);
+  }
+
+  /**
+   * Moves all streams of the recording to the timestamp of the given frame of this stream.
+   */
+  virtual bool seek(PlaybackControl& playback, int frame, int& number_of_frames)
+  {
+    boost::mutex::scoped_lock lock(control_mutex_);
+
+    if(!connected_ || !createStream()) return false;
+
+    number_of_frames = playback.getNumberOfFrames(stream_);
+
+    if(frame < 0 || frame >= number_of_frames) return false;
+
+    if(playback.seek(stream_, frame) != STATUS_OK)
+    {
+      ROS_ERROR_STREAM("Failed to seek stream '" << name_ << "': " << OpenNI::getExtendedError());
+      return false;
+    }
+
+    return true;
+  }
+
+  void requestUpdate()
+  {
+    boost::mutex::scoped_lock lock(request_mutex_);
+
+    if(!update_requested_)
+    {
+      update_requested_ = true;
+      request_time_ = ros::WallTime::now();
+    }
+
+    request_condition_.notify_one();
+  }
+
+  /**
+   * Starts or stops the stream according to the current subscribers and returns the time at which
+   * a lingering stream has to be stopped, zero if there is none.
+   */
+  ros::WallTime updateSubscriptions(const ros::WallTime& request_time)
+  {
+    boost::mutex::scoped_lock lock(control_mutex_);
+
+    // subscriptions are picked up again after reconnecting
+    if(!connected_) return ros::WallTime();
+
+    // a recorded or logged stream keeps running without subscribers
+    bool subscribed = numSubscribers() > 0 || recording_ || frame_log_ || pre_trigger_ring_;
+
+    if(subscribed)
+    {
+      linger_deadline_ = ros::WallTime();
+
+      if(!subscribed_)
+      {
+        subscribe_time_ = request_time;
+        subscribe_warm_ = running_;
+      }
+
+      if(!running_)
+      {
+        startStream();
+      }
+      else
+      {
+        // the set of subscribed topics may have changed
+        publishConfig(state_);
+      }
+    }
+    else if(running_)
+    {
+      if(linger_deadline_.isZero())
+      {
+        linger_deadline_ = request_time + ros::WallDuration(linger_time_);
+      }
+
+      if(ros::WallTime::now() >= linger_deadline_)
+      {
+        stopStream();
+        linger_deadline_ = ros::WallTime();
+      }
+    }
+    else
+    {
+      linger_deadline_ = ros::WallTime();
+    }
+
+    subscribed_ = subscribed;
+
+    return linger_deadline_;
+  }
+
+  void controlLoop()
+  {
+    ros::WallTime deadline;
+    boost::unique_lock<boost::mutex> lock(request_mutex_);
+
+    while(true)
+    {
+      while(!shutdown_requested_ && !update_requested_ && (deadline.isZero() || ros::WallTime::now() < deadline))
+      {
+        if(deadline.isZero())
+        {
+          request_condition_.wait(lock);
+        }
+        else
+        {
+          request_condition_.timed_wait(lock, boost::posix_time::microseconds(std::max<int64_t>((deadline - ros::WallTime::now()).toNSec() / 1000, 1)));
+        }
+      }
+
+      if(shutdown_requested_) break;
+
+      ros::WallTime request_time = update_requested_ ? request_time_ : ros::WallTime::now();
+      update_requested_ = false;
+
+      lock.unlock();
+      deadline = updateSubscriptions(request_time);
+      lock.lock();
+    }
+  }
+
+  void onSubscriptionChanged(const image_transport::SingleSubscriberPublisher& topic)
+  {
+    requestUpdate();
+  }
+
+  void onAuxiliarySubscriptionChanged(const ros::SingleSubscriberPublisher& topic)
+  {
+    requestUpdate();
+  }
+
+  /**
+   * Stops frame delivery and processing, derived classes call this first in their destructor
+   * so no frame is processed while their members are destroyed.
+   */
+  void detachFrameProcessing()
+  {
+    {
+      boost::mutex::scoped_lock lock(request_mutex_);
+
+      shutdown_requested_ = true;
+      request_condition_.notify_one();
+    }
+
+    if(control_thread_.joinable()) control_thread_.join();
+
+    {
+      boost::mutex::scoped_lock lock(control_mutex_);
+
+      if(stream_.isValid() && poller_ == 0) stream_.removeNewFrameListener(this);
+      stopStream();
+    }
+
+    worker_.reset();
+  }
+
+  virtual void onNewFrame(VideoStream& stream)
+  {
+    ros::Time ts = ros::Time::now();
+
+    VideoFrameRef frame;
+    stream.readFrame(&frame);
+
+    dispatchFrame(frame, ts);
+  }
+
+  void dispatchFrame(const VideoFrameRef& frame, const ros::Time& arrival)
+  {
+    clock_->update(frame.getTimestamp(), arrival);
+
+    ros::Time ts = arrival;
+
+    if(use_device_timestamps_ && clock_->isValid()) ts = clock_->toHostTime(frame.getTimestamp());
+
+    StreamConfig::ConstPtr config = loadConfig();
+
+    // frames racing a stop or reconfiguration are dropped, skipped frames cost nothing but the
+    // read, which returns the buffer to the driver
+    if(config->state != STREAM_RUNNING) return;
+
+    if(first_frame_)
+    {
+      first_frame_ = false;
+      ROS_INFO_STREAM("Stream '" << name_ << "' delivered its first frame " << (ros::WallTime::now() - startup_time_).toSec() * 1000.0 << " ms after startup.");
+    }
+
+    if(config->resume_start != handled_resume_start_)
+    {
+      handled_resume_start_ = config->resume_start;
+      recordReconfigureGap((ros::WallTime::now() - config->resume_start).toSec());
+    }
+
+    if(config->subscribe_time != handled_subscribe_time_)
+    {
+      handled_subscribe_time_ = config->subscribe_time;
+      recordTimeToFirstFrame((ros::WallTime::now() - config->subscribe_time).toSec(), config->subscribe_warm);
+    }
+
+    if(config->reconnect_start != handled_reconnect_start_)
+    {
+      handled_reconnect_start_ = config->reconnect_start;
+      recordReconnectLatency((ros::WallTime::now() - config->reconnect_start).toSec());
+    }
+
+    int frame_index = frame.getFrameIndex();
+
+    // the index restarts after reconnecting or seeking, only gaps count
+    if(last_delivered_index_ >= 0 && frame_index > last_delivered_index_ + 1)
+    {
+      recordDroppedFrames(frame_index - last_delivered_index_ - 1);
+    }
+
+    last_delivered_index_ = frame_index;
+
+    if(!throttle_.accept(*config, ts)) return;
+
+    if(worker_)
+    {
+      if(worker_->submit(frame, ts, arrival)) recordProcessingDroppedFrame();
+    }
+    else
+    {
+      processFrame(frame, ts, arrival);
+    }
+  }
+
+  void recordReconfigureGap(double gap)
+  {
+    metrics_.reconfigure_count += 1;
+    metrics_.last_reconfigure_gap = gap;
+    metrics_.max_reconfigure_gap = std::max(metrics_.max_reconfigure_gap, gap);
+
+    ROS_DEBUG_STREAM("Stream '" << name_ << "' resumed " << gap * 1000.0 << " ms after reconfiguration.");
+
+    publishMetrics();
+  }
+
+  void recordTimeToFirstFrame(double time, bool warm)
+  {
+    metrics_.subscribe_count += 1;
+    metrics_.warm_subscribe_count += warm ? 1 : 0;
+    metrics_.last_time_to_first_frame = time;
+    metrics_.max_time_to_first_frame = std::max(metrics_.max_time_to_first_frame, time);
+
+    ROS_DEBUG_STREAM("Stream '" << name_ << "' delivered its first frame " << time * 1000.0 << " ms after " << (warm ? "warm" : "cold") << " subscription.");
+
+    publishMetrics();
+  }
+
+  void recordReconnectLatency(double latency)
+  {
+    metrics_.reconnect_count += 1;
+    metrics_.last_reconnect_latency = latency;
+    metrics_.max_reconnect_latency = std::max(metrics_.max_reconnect_latency, latency);
+
+    ROS_INFO_STREAM("Stream '" << name_ << "' delivered its first frame " << latency * 1000.0 << " ms after the device was lost.");
+
+    publishMetrics();
+  }
+
+  void recordDroppedFrames(int count)
+  {
+    metrics_.dropped_frames += uint64_t(count);
+
+    ROS_DEBUG_STREAM("Stream '" << name_ << "' missed " << count << " frames.");
+
+    publishMetrics();
+  }
+
+  void recordProcessingDroppedFrame()
+  {
+    metrics_.processing_dropped_frames += 1;
+
+    ROS_DEBUG_STREAM_THROTTLE(1.0, "Stream '" << name_ << "' replaced a frame its processing thread did not get to.");
+
+    publishMetrics();
+  }
+
+  void publishMetrics()
+  {
+    StreamMetrics::Ptr metrics(new StreamMetrics(metrics_));
+    metrics->header.stamp = ros::Time::now();
+    metrics->header.frame_id = frame_id_;
+    metrics_publisher_.publish(metrics);
+  }
+
+  /**
+   * Writes the frame to the shared memory ring, copying from data if the frame was already copied
+   * and computing the statistics otherwise.
+   */
+  void publishShm(const VideoFrameRef& frame, const uint8_t* data, const ros::Time& ts, const std::string& frame_id, FrameStatistics* statistics)
+  {
+    size_t size = size_t(frame.getDataSize());
+    uint64_t sequence;
+    uint8_t* slot = shm_writer_.begin(size, sequence);
+
+    if(slot == 0)
+    {
+      ROS_ERROR_STREAM_THROTTLE(1.0, "Frame of stream '" << name_ << "' with " << size << " bytes exceeds the shared memory slot size of " << shm_writer_.maxImageSize() << " bytes!");
+
+      if(data == 0 && statistics != 0) statistics_collector_.process(frame, 0, statistics);
+      return;
+    }
+
+    if(data != 0)
+    {
+      std::memcpy(slot, data, size);
+    }
+    else
+    {
+      statistics_collector_.process(frame, slot, statistics);
+    }
+
+    ShmImageNotification::Ptr notification(new ShmImageNotification);
+    notification->header.stamp = ts;
+    notification->header.frame_id = frame_id;
+    notification->segment = shm_writer_.name();
+    notification->sequence = sequence;
+    notification->slot_count = shm_writer_.slotCount();
+    notification->width = frame.getWidth();
+    notification->height = frame.getHeight();
+    notification->encoding = toEncoding(frame.getVideoMode().getPixelFormat());
+    notification->step = frame.getStrideInBytes();
+
+    shm_writer_.commit(sequence, notification->width, notification->height, notification->step, notification->encoding, ts);
+    shm_publisher_.publish(notification);
+  }
+
+  FrameLogRecord makeFrameLogRecord(const VideoFrameRef& frame, const ros::Time& ts)
+  {
+    const VideoMode& mode = frame.getVideoMode();
+
+    FrameLogRecord record;
+    record.stream = name_;
+    record.frame_index = uint64_t(frame.getFrameIndex());
+    record.device_timestamp = frame.getTimestamp();
+    record.stamp = ts;
+    record.width = uint32_t(frame.getWidth());
+    record.height = uint32_t(frame.getHeight());
+    record.step = uint32_t(frame.getStrideInBytes());
+    record.pixel_format = int32_t(mode.getPixelFormat());
+    record.fps = int32_t(mode.getFps());
+    record.encoding = toEncoding(mode.getPixelFormat());
+
+    return record;
+  }
+
+  /**
+   * Shares the published image with the frame log and the ring, the frame is only copied if it
+   * was not published.
+   */
+  void keepFrame(const StreamConfig& config, const VideoFrameRef& frame, const ros::Time& ts, const sensor_msgs::ImageConstPtr& published)
+  {
+    if(!config.frame_log && !config.pre_trigger_ring) return;
+
+    FrameLogRecord record = makeFrameLogRecord(frame, ts);
+    sensor_msgs::ImageConstPtr image = published;
+
+    if(!image)
+    {
+      sensor_msgs::Image::Ptr copy(new sensor_msgs::Image);
+      const uint8_t* data = static_cast<const uint8_t*>(frame.getData());
+      copy->data.assign(data, data + frame.getDataSize());
+      image = copy;
+    }
+
+    if(config.frame_log) config.frame_log->add(record, image);
+    if(config.pre_trigger_ring) config.pre_trigger_ring->add(record, image);
+  }
+
+  /**
+   * ts is the published stamp, arrival the host time the frame was read at.
+   */
+  virtual void processFrame(const VideoFrameRef& frame, const ros::Time& ts, const ros::Time& arrival)
+  {
+    StreamConfig::ConstPtr config = loadConfig();
+
+    bool publish_image = config->publisher != 0 && config->publisher->getNumSubscribers() > 0;
+
+    if(publish_image && config->benchmark_gate)
+    {
+      config->benchmark_gate->enter(ts);
+    }
+    bool publish_shm = shm_writer_.isValid() && shm_publisher_.getNumSubscribers() > 0;
+    FrameStatistics::Ptr statistics;
+
+    int frame_index = frame.getFrameIndex();
+    int dropped_frames = last_frame_index_ >= 0 && frame_index > last_frame_index_ ? frame_index - last_frame_index_ - 1 : 0;
+    last_frame_index_ = frame_index;
+
+    if(statistics_publisher_.getNumSubscribers() > 0)
+    {
+      statistics.reset(new FrameStatistics);
+      statistics->header.stamp = ts;
+      statistics->header.frame_id = config->frame_id;
+      // device timestamps are on another clock, the latency is measured on the host
+      statistics->latency = float((ros::Time::now() - arrival).toSec());
+      statistics->dropped_frames = uint32_t(dropped_frames);
+    }
+
+    if(!publish_image)
+    {
+      if(publish_shm)
+      {
+        publishShm(frame, 0, ts, config->frame_id, statistics.get());
+      }
+      else if(statistics)
+      {
+        statistics_collector_.process(frame, 0, statistics.get());
+      }
+
+      if(statistics)
+      {
+        statistics_publisher_.publish(statistics);
+      }
+
+      keepFrame(*config, frame, ts, sensor_msgs::ImageConstPtr());
+
+      if(frame_history_)
+      {
+        std_msgs::Header header;
+        header.stamp = ts;
+        header.frame_id = config->frame_id;
+        frame_history_->add(header, sensor_msgs::ImageConstPtr());
+      }
+
+      return;
+    }
+
+    sensor_msgs::Image::Ptr img(new sensor_msgs::Image);
+    sensor_msgs::CameraInfo::Ptr info(new sensor_msgs::CameraInfo);
+
+    double scale = double(frame.getWidth()) / double(1280);
+
+    info->header.stamp = ts;
+    info->header.frame_id = config->frame_id;
+    info->width = frame.getWidth();
+    info->height = frame.getHeight();
+    info->K.assign(0);
+    info->K[0] = 1050.0 * scale;
+    info->K[4] = 1050.0 * scale;
+    info->K[2] = frame.getWidth() / 2.0 - 0.5;
+    info->K[5] = frame.getHeight() / 2.0 - 0.5;
+    info->P.assign(0);
+    info->P[0] = 1050.0 * scale;
+    info->P[5] = 1050.0 * scale;
+    info->P[2] = frame.getWidth() / 2.0 - 0.5;
+    info->P[6] = frame.getHeight() / 2.0 - 0.5;
+
+    img->encoding = toEncoding(frame.getVideoMode().getPixelFormat());
+    img->header.stamp = ts;
+    img->header.frame_id = config->frame_id;
+    img->height = frame.getHeight();
+    img->width = frame.getWidth();
+    img->step = frame.getStrideInBytes();
+    img->data.resize(frame.getDataSize());
+    statistics_collector_.process(frame, &img->data[0], statistics.get());
+
+    // from here on the messages are shared with intra-process subscribers and must not change,
+    // publishing the pointers lets nodelets in the same manager receive them without a copy
+    sensor_msgs::ImageConstPtr image_message(img);
+    sensor_msgs::CameraInfoConstPtr info_message(info);
+    img.reset();
+    info.reset();
+
+    if(PublishedImageRegistry::isEnabled()) PublishedImageRegistry::instance().add(image_message);
+    config->publisher->publish(image_message, info_message);
+
+    if(publish_shm)
+    {
+      publishShm(frame, &image_message->data[0], ts, config->frame_id, 0);
+    }
+
+    if(statistics)
+    {
+      statistics_publisher_.publish(statistics);
+    }
+
+    keepFrame(*config, frame, ts, image_message);
+
+    if(frame_history_)
+    {
+      frame_history_->add(image_message->header, frameset_images_ ? image_message : sensor_msgs::ImageConstPtr());
+    }
+  }
+};
+
+class DepthSensorStreamManager : public SensorStreamManager
+{
+protected:
+  ros::NodeHandle nh_registered_;
+  image_transport::ImageTransport it_registered_;
+  image_transport::CameraPublisher depth_registered_publisher_, disparity_publisher_, disparity_registered_publisher_;
+  std::string rgb_frame_id_, depth_frame_id_;
+  bool registration_;
+
+  virtual void buildConfig(StreamConfig& config)
+  {
+    image_transport::CameraPublisher *p_depth, *p_disparity;
+
+    if(registration_)
+    {
+      p_depth = &depth_registered_publisher_;
+      p_disparity = &disparity_registered_publisher_;
+      config.frame_id = rgb_frame_id_;
+    }
+    else
+    {
+      p_depth = &publisher_;
+      p_disparity = &disparity_publisher_;
+      config.frame_id = depth_frame_id_;
+    }
+
+    if(video_mode_.getPixelFormat() == PIXEL_FORMAT_DEPTH_1_MM)
+    {
+      config.publisher = p_depth;
+    }
+    else if(video_mode_.getPixelFormat() == PIXEL_FORMAT_SHIFT_9_2)
+    {
+      config.publisher = p_disparity;
+    }
+    else
+    {
+      config.publisher = 0;
+    }
+  }
+public:
+  DepthSensorStreamManager(ros::NodeHandle& nh, ros::NodeHandle& nh_private, Device& device, std::string rgb_frame_id, std::string depth_frame_id, VideoMode& default_mode, const ros::WallTime& startup_time, FramePoller* poller, const boost::shared_ptr<FrameWorkerPool>& pool, const boost::shared_ptr<DeviceClockEstimator>& clock) :
+    SensorStreamManager(nh, nh_private, device, SENSOR_DEPTH, "depth", depth_frame_id, default_mode, startup_time, poller, pool, clock),
+    nh_registered_(nh, "depth_registered"),
+    it_registered_(nh_registered_),
+    rgb_frame_id_(rgb_frame_id),
+    depth_frame_id_(depth_frame_id),
+    registration_(false)
+  {
+    depth_registered_publisher_ = it_registered_.advertiseCamera("image_raw", 1, callback_, callback_);
+    disparity_publisher_ = it_.advertiseCamera("disparity", 1, callback_, callback_);
+    disparity_registered_publisher_ = it_registered_.advertiseCamera("disparity", 1, callback_, callback_);
+  }
+
+  virtual ~DepthSensorStreamManager()
+  {
+    detachFrameProcessing();
+  }
+
+  bool applyRegistration(bool enabled)
+  {
+    ImageRegistrationMode mode = enabled ? IMAGE_REGISTRATION_DEPTH_TO_COLOR : IMAGE_REGISTRATION_OFF;
+
+    if(enabled && !device_.isImageRegistrationModeSupported(mode)) return false;
+
+    if(device_.getImageRegistrationMode() != mode)
+    {
+      ROS_ERROR_STREAM_COND(device_.setImageRegistrationMode(mode) != STATUS_OK, "Failed to set image registration mode!");
+    }
+
+    return true;
+  }
+
+  virtual bool configureRegistration(bool enabled)
+  {
+    boost::mutex::scoped_lock lock(control_mutex_);
+
+    // while the device is lost the mode is only remembered and applied on reconnect
+    if(connected_ && !applyRegistration(enabled)) return false;
+
+    if(registration_ != enabled)
+    {
+      registration_ = enabled;
+
+      // registration is applied while streaming, only the frame id and publisher change
+      publishConfig(state_);
+    }
+
+    return true;
+  }
+
+  virtual void reconnect(const ros::WallTime& disconnect_time)
+  {
+    {
+      boost::mutex::scoped_lock lock(control_mutex_);
+
+      if(!applyRegistration(registration_))
+      {
+        ROS_WARN_STREAM("Image registration is not supported after reconnect, disabling it!");
+        registration_ = false;
+        publishConfig(state_);
+      }
+    }
+
+    SensorStreamManager::reconnect(disconnect_time);
+  }
+
+  virtual size_t numSubscribers()
+  {
+    size_t disparity_clients = disparity_publisher_.getNumSubscribers() + disparity_registered_publisher_.getNumSubscribers();
+    size_t depth_clients = publisher_.getNumSubscribers() + depth_registered_publisher_.getNumSubscribers();
+
+    return disparity_clients + depth_clients + numAuxiliarySubscribers();
+  }
+};
+
+class CameraImpl
+{
+public:
+  CameraImpl(ros::NodeHandle& nh, ros::NodeHandle& nh_private, const openni::DeviceInfo& device_info, const boost::shared_ptr<FrameWorkerPool>& pool) :
+    rgb_sensor_(new SensorStreamManagerBase()),
+    depth_sensor_(new SensorStreamManagerBase()),
+    ir_sensor_(new SensorStreamManagerBase()),
+    reconfigure_server_(nh_private),
+    uri_(device_info.getUri()),
+    connected_(false),
+    usb_interface_(-1),
+    profile_loaded_(false),
+    playback_(0)
+  {
+    ros::WallTime startup_time = ros::WallTime::now();
+
+    double usb_bus_budget;
+    nh_private.param("usb_bus_budget", usb_bus_budget, 40.0);
+    UsbBandwidthPlanner::instance().setBudget(usb_bus_budget * 1e6);
+
+    std::string usb_interface;
+    nh_private.param("usb_interface", usb_interface, std::string("default"));
+
+    if(usb_interface == "iso")
+    {
+      usb_interface_ = XN_SENSOR_USB_INTERFACE_ISO_ENDPOINTS;
+    }
+    else if(usb_interface == "bulk")
+    {
+      usb_interface_ = XN_SENSOR_USB_INTERFACE_BULK_ENDPOINTS;
+    }
+    else if(usb_interface == "iso_low_depth")
+    {
+      usb_interface_ = XN_SENSOR_USB_INTERFACE_ISO_ENDPOINTS_LOW_DEPTH;
+    }
+    else if(usb_interface != "default")
+    {
+      ROS_WARN_STREAM("Unknown usb_interface '" << usb_interface << "', using the device default!");
+    }
+
+    connected_ = (device_.open(device_info.getUri()) == STATUS_OK);
+
+    if(connected_)
+    {
+      serial_ = readSerialNumber();
+    }
+    else
+    {
+      ROS_WARN_STREAM("Failed to open device '" << uri_ << "', advertising its topics until it can be opened: " << OpenNI::getExtendedError());
+    }
+
+    // recordings are replayed through their playback control, USB and caching settings do not apply
+    if(connected_ && device_.isFile()) playback_ = device_.getPlaybackControl();
+
+    applyUsbInterface();
+
+    // the device clock outlives reconnects, a restarted clock is detected by the estimator
+    clock_ = MultiDeviceClock::instance().clock(serial_.empty() || playback_ ? uri_ : serial_);
+
+    if(playback_)
+    {
+      double playback_speed;
+      bool playback_repeat, benchmark;
+      nh_private.param("playback_speed", playback_speed, 1.0);
+      nh_private.param("playback_repeat", playback_repeat, true);
+      nh_private.param("benchmark", benchmark, false);
+
+      // a benchmark ends with the recording
+      playback_repeat = playback_repeat && !benchmark;
+
+      applyPlayback(playback_speed, playback_repeat);
+      clock_->setPlayback(true);
+    }
+
+    ros::WallTime open_time = ros::WallTime::now();
+
+    bool profile_cache;
+    nh_private.param("capability_cache", profile_cache, true);
+    if(profile_cache && !playback_) profile_cache_ = cacheDirectory();
+
+    // the profile is only needed once reconfiguration starts, load it while the stream managers are
+    // set up, a device which is not open yet is profiled when it is opened
+    boost::thread info_thread;
+    if(connected_) info_thread = boost::thread(&CameraImpl::loadProfile, this);
+
+    buildResolutionMap();
+
+    std::string rgb_frame_id, depth_frame_id;
+    nh_private.param(std::string("rgb_frame_id"), rgb_frame_id, std::string("camera_rgb_optical_frame"));
+    nh_private.param(std::string("depth_frame_id"), depth_frame_id, std::string("camera_depth_optical_frame"));
+
+    std::string acquisition_mode;
+    nh_private.param(std::string("acquisition_mode"), acquisition_mode, std::string("listener"));
+
+    if(acquisition_mode == "polling")
+    {
+      double batch_window;
+      nh_private.param(std::string("polling_batch_window"), batch_window, 0.01);
+
+      poller_.reset(new FramePoller(ThreadOptions::fromParameters(nh_private, "polling", "openni2_polling"), ros::WallDuration(batch_window)));
+    }
+    else if(acquisition_mode != "listener")
+    {
+      ROS_WARN_STREAM("Unknown acquisition_mode '" << acquisition_mode << "', using 'listener'!");
+    }
+
+    // without the device its sensors are unknown, the streams of a typical camera are created so
+    // their topics exist before the device is opened
+    if(!connected_ || device_.hasSensor(SENSOR_COLOR))
+    {
+      rgb_sensor_.reset(new SensorStreamManager(nh, nh_private, device_, SENSOR_COLOR, "rgb", rgb_frame_id, resolutions_[Camera_RGB_640x480_30Hz], startup_time, poller_.get(), pool, clock_));
+    }
+
+    if(!connected_ || device_.hasSensor(SENSOR_DEPTH))
+    {
+      depth_sensor_.reset(new DepthSensorStreamManager(nh, nh_private, device_, rgb_frame_id, depth_frame_id, resolutions_[Camera_DEPTH_640x480_30Hz], startup_time, poller_.get(), pool, clock_));
+    }
+
+    if(!connected_ || device_.hasSensor(SENSOR_IR))
+    {
+      ir_sensor_.reset(new SensorStreamManager(nh, nh_private, device_, SENSOR_IR, "ir", depth_frame_id, resolutions_[Camera_IR_640x480_30Hz], startup_time, poller_.get(), pool, clock_));
+    }
+
+    if(!connected_)
+    {
+      rgb_sensor_->disconnect();
+      depth_sensor_->disconnect();
+      ir_sensor_->disconnect();
+    }
+
+    rgb_sensor_->start();
+    depth_sensor_->start();
+    ir_sensor_->start();
+
+    ros::WallTime setup_time = ros::WallTime::now();
+
+    if(info_thread.joinable()) info_thread.join();
+
+    if(connected_) device_.setDepthColorSyncEnabled(true);
+
+    reconfigure_server_.setCallback(boost::bind(&CameraImpl::configure, this, _1, _2));
+
+    clock_publisher_ = nh.advertise<DeviceClock>("device_clock", 1, true);
+    clock_timer_ = nh.createWallTimer(ros::WallDuration(1.0), &CameraImpl::publishDeviceClock, this);
+    frameset_service_ = nh.advertiseService("get_frameset", &CameraImpl::getFrameset, this);
+
+    openFrameLog(nh_private);
+    createPreTriggerRing(nh_private);
+    createBenchmarkGate(nh, nh_private);
+
+    start_recording_service_ = nh_private.advertiseService("start_recording", &CameraImpl::startRecording, this);
+    stop_recording_service_ = nh_private.advertiseService("stop_recording", &CameraImpl::stopRecording, this);
+
+    if(playback_)
+    {
+      set_playback_service_ = nh_private.advertiseService("set_playback", &CameraImpl::setPlayback, this);
+      seek_playback_service_ = nh_private.advertiseService("seek_playback", &CameraImpl::seekPlayback, this);
+    }
+
+    ros::WallTime ready_time = ros::WallTime::now();
+
+    ROS_INFO_STREAM("Camera ready after " << (ready_time - startup_time).toSec() * 1000.0 << " ms (device open " << (open_time - startup_time).toSec() * 1000.0 << " ms, stream setup " << (setup_time - open_time).toSec() * 1000.0 << " ms, configuration " << (ready_time - setup_time).toSec() * 1000.0 << " ms), streams are created on first subscription.");
+  }
+
+  ~CameraImpl()
+  {
+    stopRecorder();
+
+    // frames waiting for acknowledgements would delay stopping the streams
+    if(benchmark_gate_) benchmark_gate_->stop();
+
+    rgb_sensor_.reset();
+    depth_sensor_.reset();
+    ir_sensor_.reset();
+
+    // stops a running dump, the frames written so far stay readable
+    dump_frames_service_.shutdown();
+    pre_trigger_ring_.reset();
+
+    if(frame_log_)
+    {
+      frame_log_->close();
+
+      ROS_INFO_STREAM("Wrote " << frame_log_->frames() << " frames to frame log '" << frame_log_->file() << "'.");
+      ROS_WARN_STREAM_COND(frame_log_->droppedFrames() > 0, "Dropped " << frame_log_->droppedFrames() << " frames the frame log could not keep up with!");
+    }
+
+    device_.close();
+  }
+
+  SensorStreamManagerBase* sensorByName(const std::string& name) const
+  {
+    return name == "rgb" ? rgb_sensor_.get() : name == "depth" ? depth_sensor_.get() : name == "ir" ? ir_sensor_.get() : 0;
+  }
+
+  /**
+   * The pre-trigger ring keeps the frames of the streams listed in ~pre_trigger_streams for the
+   * last ~pre_trigger_duration seconds, limited to ~pre_trigger_size MB, until they are dumped.
+   */
+  void createPreTriggerRing(ros::NodeHandle& nh_private)
+  {
+    double duration, size;
+    std::string streams;
+    nh_private.param("pre_trigger_duration", duration, 0.0);
+    nh_private.param("pre_trigger_size", size, 0.0);
+    nh_private.param("pre_trigger_streams", streams, std::string("depth rgb"));
+
+    if(duration <= 0.0 && size <= 0.0) return;
+
+    pre_trigger_ring_.reset(new PreTriggerRing(duration, size_t(std::max(size, 0.0) * 1e6), ThreadOptions::fromParameters(nh_private, "pre_trigger_dump", "openni2_dump")));
+
+    std::istringstream names(streams);
+    std::string name;
+
+    while(names >> name)
+    {
+      SensorStreamManagerBase* sensor = sensorByName(name);
+
+      if(sensor != 0)
+      {
+        sensor->setPreTriggerRing(pre_trigger_ring_);
+      }
+      else
+      {
+        ROS_WARN_STREAM("Unknown stream '" << name << "' in ~pre_trigger_streams!");
+      }
+    }
+
+    dump_frames_service_ = nh_private.advertiseService("dump_frames", &CameraImpl::dumpFrames, this);
+
+    ROS_INFO_STREAM("Keeping frames of " << streams << " in memory for dumping.");
+  }
+
+  bool dumpFrames(DumpFrames::Request& request, DumpFrames::Response& response)
+  {
+    response.success = pre_trigger_ring_->dump(request.filename, std::max(request.post_trigger_duration, 0.0), response.message);
+    ROS_INFO_STREAM_COND(response.success, response.message);
+
+    return true;
+  }
+
+  /**
+   * With ~benchmark a recording is replayed as fast as the pipeline keeps up: at most
+   * ~benchmark_window published frames wait for their acknowledgement on benchmark_ack, or for
+   * ~benchmark_ack_timeout seconds. See pipeline_benchmark.
+   */
+  void createBenchmarkGate(ros::NodeHandle& nh, ros::NodeHandle& nh_private)
+  {
+    bool benchmark;
+    int window;
+    double timeout;
+    nh_private.param("benchmark", benchmark, false);
+    nh_private.param("benchmark_window", window, 4);
+    nh_private.param("benchmark_ack_timeout", timeout, 1.0);
+
+    if(!benchmark) return;
+
+    if(!playback_)
+    {
+      ROS_WARN("~benchmark needs a recording as device_id, ignoring it.");
+      return;
+    }
+
+    benchmark_gate_.reset(new BenchmarkGate(size_t(std::max(window, 1)), ros::WallDuration(std::max(timeout, 0.0))));
+
+    rgb_sensor_->setBenchmarkGate(benchmark_gate_);
+    depth_sensor_->setBenchmarkGate(benchmark_gate_);
+    ir_sensor_->setBenchmarkGate(benchmark_gate_);
+
+    benchmark_ack_subscriber_ = nh.subscribe("benchmark_ack", 10, &BenchmarkGate::acknowledge, benchmark_gate_.get(), ros::TransportHints().tcpNoDelay());
+
+    ROS_INFO_STREAM("Benchmark mode, publishing at most " << window << " unacknowledged frames.");
+  }
+
+  /**
+   * ~frame_log is the file to log the raw frames of the streams listed in ~frame_log_streams to.
+   * The frames are written by a thread configured by ~frame_log_thread_*, up to
+   * ~frame_log_queue_size MB of them wait for it before frames are dropped.
+   */
+  void openFrameLog(ros::NodeHandle& nh_private)
+  {
+    std::string file, streams;
+    double queue_size;
+    nh_private.param("frame_log", file, std::string());
+    nh_private.param("frame_log_streams", streams, std::string("depth rgb"));
+    nh_private.param("frame_log_queue_size", queue_size, 256.0);
+
+    if(file.empty()) return;
+
+    boost::shared_ptr<FrameLogWriter> writer(new FrameLogWriter);
+
+    if(!writer->open(file)) return;
+
+    frame_log_.reset(new FrameLogQueue(writer, size_t(std::max(queue_size, 0.0) * 1e6), ThreadOptions::fromParameters(nh_private, "frame_log", "openni2_log")));
+
+    std::istringstream names(streams);
+    std::string name;
+
+    while(names >> name)
+    {
+      SensorStreamManagerBase* sensor = sensorByName(name);
+
+      if(sensor != 0)
+      {
+        sensor->setFrameLog(frame_log_);
+      }
+      else
+      {
+        ROS_WARN_STREAM("Unknown stream '" << name << "' in ~frame_log_streams!");
       }
     }
+
+    ROS_INFO_STREAM("Logging frames of " << streams << " to '" << file << "'.");
   }
 
-  virtual bool tryConfigureVideoMode(VideoMode& mode)
+  void publishDeviceClock(const ros::WallTimerEvent& event)
   {
-    bool result = true;
-    VideoMode old = stream_.getVideoMode();
+    if(!clock_->isValid()) return;
+
+    DeviceClock::Ptr msg(new DeviceClock);
+    msg->header.stamp = ros::Time::now();
 
-    if(stream_.setVideoMode(mode) != STATUS_OK)
     {
-      ROS_ERROR_STREAM_COND(stream_.setVideoMode(old) != STATUS_OK, "Failed to recover old video mode!");
-      result = false;
+      boost::mutex::scoped_lock lock(device_mutex_);
+      msg->serial = serial_;
     }
 
-    return result;
+    msg->offset = clock_->offset();
+    msg->drift_ppm = clock_->drift() * 1e6;
+    msg->jitter = clock_->jitter();
+    msg->samples = clock_->samples();
+
+    clock_publisher_.publish(msg);
+  }
+
+  bool getFrameset(GetFrameset::Request& request, GetFrameset::Response& response)
+  {
+    return MultiDeviceClock::instance().getFrameset(request, response);
   }
 
-  virtual void onSubscriptionChanged(const image_transport::SingleSubscriberPublisher& topic)
+  /**
+   * Frames are written by OpenNI from the streams directly, nothing is published or serialized.
+   */
+  bool startRecording(StartRecording::Request& request, StartRecording::Response& response)
   {
-    if(topic.getNumSubscribers() > 0)
+    boost::mutex::scoped_lock lock(recording_mutex_);
+
+    response.success = false;
+
+    if(recorder_)
     {
-      if(!running_ && stream_.start() == STATUS_OK)
-      {
-        running_ = true;
-      }
+      response.message = "Already recording to '" + recording_file_ + "'.";
+      return true;
     }
-    else
+
+    boost::scoped_ptr<Recorder> recorder(new Recorder);
+
+    if(recorder->create(request.filename.c_str()) != STATUS_OK)
     {
-      stream_.stop();
-      running_ = false;
+      response.message = std::string("Failed to create recording: ") + OpenNI::getExtendedError();
+      return true;
     }
-  }
-
-  virtual void onNewFrame(VideoStream& stream)
-  {
-    ros::Time ts = ros::Time::now();
 
-    VideoFrameRef frame;
-    stream.readFrame(&frame);
+    const char* names[] = { "rgb", "depth", "ir" };
+    SensorStreamManagerBase* sensors[] = { rgb_sensor_.get(), depth_sensor_.get(), ir_sensor_.get() };
+    std::string recorded;
 
-    sensor_msgs::Image::Ptr img(new sensor_msgs::Image);
-    sensor_msgs::CameraInfo::Ptr info(new sensor_msgs::CameraInfo);
+    for(size_t idx = 0; idx < 3; ++idx)
+    {
+      bool requested = std::find(request.streams.begin(), request.streams.end(), names[idx]) != request.streams.end();
 
-    double scale = double(frame.getWidth()) / double(1280);
+      if(!request.streams.empty() && !requested) continue;
 
-    info->header.stamp = ts;
-    info->header.frame_id = frame_id_;
-    info->width = frame.getWidth();
-    info->height = frame.getHeight();
-    info->K.assign(0);
-    info->K[0] = 1050.0 * scale;
-    info->K[4] = 1050.0 * scale;
-    info->K[2] = frame.getWidth() / 2.0 - 0.5;
-    info->K[5] = frame.getHeight() / 2.0 - 0.5;
-    info->P.assign(0);
-    info->P[0] = 1050.0 * scale;
-    info->P[5] = 1050.0 * scale;
-    info->P[2] = frame.getWidth() / 2.0 - 0.5;
-    info->P[6] = frame.getHeight() / 2.0 - 0.5;
+      if(sensors[idx]->attachRecorder(*recorder, request.allow_lossy_compression, requested))
+      {
+        recorded += recorded.empty() ? names[idx] : std::string(", ") + names[idx];
+      }
+      else if(requested)
+      {
+        ROS_WARN_STREAM("Stream '" << names[idx] << "' cannot be recorded.");
+      }
+    }
 
-    switch(frame.getVideoMode().getPixelFormat())
+    if(recorded.empty() || recorder->start() != STATUS_OK)
     {
-    case PIXEL_FORMAT_GRAY8:
-      img->encoding = sensor_msgs::image_encodings::MONO8;
-      break;
-    case PIXEL_FORMAT_GRAY16:
-      img->encoding = sensor_msgs::image_encodings::MONO16;
-      break;
-    case PIXEL_FORMAT_YUV422:
-      img->encoding = sensor_msgs::image_encodings::YUV422;
-      break;
-    case PIXEL_FORMAT_RGB888:
-      img->encoding = sensor_msgs::image_encodings::RGB8;
-      break;
-    case PIXEL_FORMAT_SHIFT_9_2:
-    case PIXEL_FORMAT_DEPTH_1_MM:
-      img->encoding = sensor_msgs::image_encodings::TYPE_16UC1;
-      break;
-    default:
-      ROS_WARN("Unknown OpenNI pixel format!");
-      break;
+      response.message = recorded.empty() ? "No stream to record." : std::string("Failed to start recording: ") + OpenNI::getExtendedError();
+
+      recorder->destroy();
+      rgb_sensor_->detachRecorder();
+      depth_sensor_->detachRecorder();
+      ir_sensor_->detachRecorder();
+      return true;
     }
-    img->header.stamp = ts;
-    img->header.frame_id = frame_id_;
-    img->height = frame.getHeight();
-    img->width = frame.getWidth();
-    img->step = frame.getStrideInBytes();
-    img->data.resize(frame.getDataSize());
-    std::copy(static_cast<const uint8_t*>(frame.getData()), static_cast<const uint8_t*>(frame.getData()) + frame.getDataSize(), img->data.begin());
 
-    publish(img, info);
+    recorder_.swap(recorder);
+    recording_file_ = request.filename;
+
+    response.success = true;
+    response.message = "Recording " + recorded + " to '" + recording_file_ + "'.";
+    ROS_INFO_STREAM(response.message);
+
+    return true;
   }
-};
 
-class DepthSensorStreamManager : public SensorStreamManager
-{
-protected:
-  ros::NodeHandle nh_registered_;
-  image_transport::ImageTransport it_registered_;
-  image_transport::CameraPublisher depth_registered_publisher_, disparity_publisher_, disparity_registered_publisher_, *active_publisher_;
-  std::string rgb_frame_id_, depth_frame_id_;
+  bool stopRecording(std_srvs::Empty::Request& request, std_srvs::Empty::Response& response)
+  {
+    stopRecorder();
+    return true;
+  }
 
-  virtual void publish(sensor_msgs::Image::Ptr& image, sensor_msgs::CameraInfo::Ptr& camera_info)
+  void stopRecorder()
   {
-    if(active_publisher_ != 0)
-      active_publisher_->publish(image, camera_info);
+    boost::mutex::scoped_lock lock(recording_mutex_);
+
+    if(!recorder_) return;
+
+    recorder_->stop();
+    recorder_->destroy();
+    recorder_.reset();
+
+    rgb_sensor_->detachRecorder();
+    depth_sensor_->detachRecorder();
+    ir_sensor_->detachRecorder();
+
+    ROS_INFO_STREAM("Stopped recording to '" << recording_file_ << "'.");
   }
 
-  void updateActivePublisher()
+  /**
+   * speed is the ratio to the recorded frame rate, zero or less replays as fast as possible.
+   */
+  bool applyPlayback(double speed, bool repeat)
   {
-    image_transport::CameraPublisher *p_depth, *p_disparity;
+    boost::mutex::scoped_lock lock(device_mutex_);
 
-    if(device_.getImageRegistrationMode() == IMAGE_REGISTRATION_DEPTH_TO_COLOR)
-    {
-      p_depth = &depth_registered_publisher_;
-      p_disparity = &disparity_registered_publisher_;
-      frame_id_ = rgb_frame_id_;
-    }
-    else
+    bool success = true;
+
+    if(playback_->setSpeed(speed > 0.0 ? float(speed) : PLAYBACK_SPEED_FASTEST) != STATUS_OK)
     {
-      p_depth = &publisher_;
-      p_disparity = &disparity_publisher_;
-      frame_id_ = depth_frame_id_;
+      ROS_ERROR_STREAM("Failed to set playback speed: " << OpenNI::getExtendedError());
+      success = false;
     }
 
-    if(stream_.getVideoMode().getPixelFormat() == PIXEL_FORMAT_DEPTH_1_MM)
+    if(playback_->setRepeatEnabled(repeat) != STATUS_OK)
     {
-      active_publisher_ = p_depth;
+      ROS_ERROR_STREAM("Failed to set playback repeat: " << OpenNI::getExtendedError());
+      success = false;
     }
-    else if(stream_.getVideoMode().getPixelFormat() == PIXEL_FORMAT_SHIFT_9_2)
+
+    if(success && speed > 0.0)
     {
-      active_publisher_ = p_disparity;
+      ROS_INFO_STREAM("Playing back '" << uri_ << "' at " << speed << "x speed" << (repeat ? ", repeating." : ", once."));
     }
-    else
+    else if(success)
     {
-      active_publisher_ = 0;
+      ROS_INFO_STREAM("Playing back '" << uri_ << "' as fast as possible" << (repeat ? ", repeating." : ", once."));
     }
+
+    return success;
   }
-public:
-  DepthSensorStreamManager(ros::NodeHandle& nh, Device& device, std::string rgb_frame_id, std::string depth_frame_id, VideoMode& default_mode) :
-    SensorStreamManager(nh, device, SENSOR_DEPTH, "depth", depth_frame_id, default_mode),
-    nh_registered_(nh, "depth_registered"),
-    it_registered_(nh_registered_),
-    active_publisher_(0),
-    rgb_frame_id_(rgb_frame_id),
-    depth_frame_id_(depth_frame_id)
+
+  bool setPlayback(SetPlayback::Request& request, SetPlayback::Response& response)
   {
-    depth_registered_publisher_ = it_registered_.advertiseCamera("image_raw", 1, callback_, callback_);
-    disparity_publisher_ = it_.advertiseCamera("disparity", 1, callback_, callback_);
-    disparity_registered_publisher_ = it_registered_.advertiseCamera("disparity", 1, callback_, callback_);
+    response.success = applyPlayback(request.speed, request.repeat);
+    if(!response.success) response.message = OpenNI::getExtendedError();
+
+    return true;
   }
 
-  virtual void onSubscriptionChanged(const image_transport::SingleSubscriberPublisher& topic)
+  bool seekPlayback(SeekPlayback::Request& request, SeekPlayback::Response& response)
   {
-    size_t disparity_clients = disparity_publisher_.getNumSubscribers() + disparity_registered_publisher_.getNumSubscribers();
-    size_t depth_clients = publisher_.getNumSubscribers() + depth_registered_publisher_.getNumSubscribers();
-    size_t all_clients = disparity_clients + depth_clients;
+    SensorStreamManagerBase* sensor = sensorByName(request.stream);
 
-    if(!running_ && all_clients > 0)
+    response.success = false;
+    response.number_of_frames = 0;
+
+    if(sensor == 0)
     {
-      running_ = (stream_.start() == STATUS_OK);
+      response.message = "Unknown stream '" + request.stream + "'.";
+      return true;
     }
-    else if(running_ && all_clients == 0)
+
     {
-      stream_.stop();
-      running_ = false;
+      boost::mutex::scoped_lock lock(device_mutex_);
+
+      response.success = sensor->seek(*playback_, request.frame, response.number_of_frames);
     }
 
-    if(running_)
+    if(response.success)
     {
-      updateActivePublisher();
+      // the recorded timestamps jump, anchor them anew at the next frame
+      clock_->restart();
     }
+    else
+    {
+      response.message = "Cannot seek stream '" + request.stream + "' to frame " + boost::lexical_cast<std::string>(request.frame) + " of " + boost::lexical_cast<std::string>(response.number_of_frames) + ".";
+    }
+
+    return true;
   }
 
-  virtual void endConfigure()
+  /**
+   * The endpoint type has to be chosen before any stream is created.
+   */
+  void applyUsbInterface()
   {
-    SensorStreamManager::endConfigure();
+    if(usb_interface_ < 0 || playback_ || !connected_) return;
 
-    if(running_)
-    {
-      updateActivePublisher();
-    }
+    ROS_ERROR_STREAM_COND(device_.setProperty(XN_MODULE_PROPERTY_USB_INTERFACE, usb_interface_) != STATUS_OK, "Failed to set USB interface!");
   }
-};
 
-class CameraImpl
-{
-public:
-  CameraImpl(ros::NodeHandle& nh, ros::NodeHandle& nh_private, const openni::DeviceInfo& device_info) :
-    rgb_sensor_(new SensorStreamManagerBase()),
-    depth_sensor_(new SensorStreamManagerBase()),
-    ir_sensor_(new SensorStreamManagerBase()),
-    reconfigure_server_(nh_private)
+  std::string readSerialNumber()
   {
-    device_.open(device_info.getUri());
+    char buffer[64] = { 0 };
+    int size = sizeof(buffer) - 1;
 
-    printDeviceInfo();
-    printVideoModes();
-    buildResolutionMap();
+    return device_.getProperty(DEVICE_PROPERTY_SERIAL_NUMBER, buffer, &size) == STATUS_OK ? std::string(buffer) : std::string();
+  }
 
-    device_.setDepthColorSyncEnabled(true);
+  std::string serial()
+  {
+    boost::mutex::scoped_lock lock(device_mutex_);
+    return serial_;
+  }
 
-    std::string rgb_frame_id, depth_frame_id;
-    nh_private.param(std::string("rgb_frame_id"), rgb_frame_id, std::string("camera_rgb_optical_frame"));
-    nh_private.param(std::string("depth_frame_id"), depth_frame_id, std::string("camera_depth_optical_frame"));
+  std::string uri()
+  {
+    boost::mutex::scoped_lock lock(device_mutex_);
+    return uri_;
+  }
 
-    if(device_.hasSensor(SENSOR_COLOR))
-    {
-      rgb_sensor_.reset(new SensorStreamManager(nh, device_, SENSOR_COLOR, "rgb", rgb_frame_id, resolutions_[Camera_RGB_640x480_30Hz]));
-    }
+  bool isConnected()
+  {
+    boost::mutex::scoped_lock lock(device_mutex_);
+    return connected_;
+  }
 
-    if(device_.hasSensor(SENSOR_DEPTH))
-    {
-      depth_sensor_.reset(new DepthSensorStreamManager(nh, device_, rgb_frame_id, depth_frame_id, resolutions_[Camera_DEPTH_640x480_30Hz]));
-    }
+  /**
+   * Drops all streams of a lost device, the publishers and settings are kept.
+   */
+  void disconnect()
+  {
+    boost::mutex::scoped_lock lock(device_mutex_);
 
-    if(device_.hasSensor(SENSOR_IR))
-    {
-      ir_sensor_.reset(new SensorStreamManager(nh, device_, SENSOR_IR, "ir", depth_frame_id, resolutions_[Camera_IR_640x480_30Hz]));
-    }
+    if(!connected_) return;
 
-    reconfigure_server_.setCallback(boost::bind(&CameraImpl::configure, this, _1, _2));
-  }
+    // the recorder must not outlive the streams it records
+    stopRecorder();
 
-  ~CameraImpl()
-  {
-    rgb_sensor_.reset();
-    depth_sensor_.reset();
-    ir_sensor_.reset();
+    disconnect_time_ = ros::WallTime::now();
+    connected_ = false;
+
+    rgb_sensor_->disconnect();
+    depth_sensor_->disconnect();
+    ir_sensor_->disconnect();
 
     device_.close();
   }
 
-  void printDeviceInfo()
+  /**
+   * Opens the device again, possibly at a new uri, and restores the configuration.
+   */
+  bool reconnect(const DeviceInfo& device_info)
   {
-    const DeviceInfo& info = device_.getDeviceInfo();
+    boost::mutex::scoped_lock lock(device_mutex_);
 
-    char buffer[512];
-    int size = 512;
-    std::stringstream summary;
+    if(connected_) return true;
 
-    size = 512;
-    if(device_.getProperty(DEVICE_PROPERTY_HARDWARE_VERSION, buffer, &size) == STATUS_OK)
+    if(device_.open(device_info.getUri()) != STATUS_OK)
     {
-      std::string hw(buffer, size_t(size));
-      summary << " Hardware: " << hw;
+      ROS_WARN_STREAM("Failed to reopen device '" << device_info.getUri() << "': " << OpenNI::getExtendedError());
+      return false;
     }
 
-    size = 512;
-    if(device_.getProperty(DEVICE_PROPERTY_FIRMWARE_VERSION, buffer, &size) == STATUS_OK)
+    uri_ = device_info.getUri();
+    connected_ = true;
+
+    // a device which could not be opened at startup is identified and profiled now
+    if(serial_.empty()) serial_ = readSerialNumber();
+    if(!profile_loaded_) loadProfile();
+
+    applyUsbInterface();
+    device_.setDepthColorSyncEnabled(true);
+
+    rgb_sensor_->reconnect(disconnect_time_);
+    depth_sensor_->reconnect(disconnect_time_);
+    ir_sensor_->reconnect(disconnect_time_);
+
+    ROS_INFO_STREAM("Reopened device '" << serial_ << "' at '" << uri_ << "' " << (ros::WallTime::now() - disconnect_time_).toSec() * 1000.0 << " ms after it was lost.");
+
+    return true;
+  }
+
+  /**
+   * Loads the capabilities from the cache, or queries and caches them, then logs them.
+   */
+  void loadProfile()
+  {
+    std::string file = profile_cache_.empty() || serial_.empty() ? std::string() : profile_cache_ + "/profile_" + serial_;
+    DeviceProfile profile;
+
+    if(file.empty() || !profile.load(file, device_))
+    {
+      profile.query(device_);
+
+      ROS_WARN_STREAM_COND(!file.empty() && !profile.save(file), "Failed to write device profile '" << file << "'!");
+    }
+    else
     {
-      std::string fw(buffer, size);
-      summary << " Firmware: " << fw;
+      ROS_DEBUG_STREAM("Using cached device profile '" << file << "'.");
     }
 
-    size = 512;
-    if(device_.getProperty(DEVICE_PROPERTY_DRIVER_VERSION, buffer, &size) == STATUS_OK)
     {
-      std::string drv(buffer, size);
-      summary << " Driver: " << drv;
+      boost::mutex::scoped_lock lock(profile_mutex_);
+      profile_ = profile;
+      profile_loaded_ = true;
     }
 
-    ROS_INFO_STREAM(info.getVendor() << " " << info.getName() << summary.str());
+    printDeviceInfo();
+    printVideoModes();
   }
 
-  void printVideoModes()
+  void printDeviceInfo()
   {
-    static const size_t ntypes = 3;
-    SensorType types[ntypes] = { SENSOR_COLOR, SENSOR_DEPTH, SENSOR_IR };
+    std::stringstream summary;
 
-    for(size_t tidx = 0; tidx < ntypes; ++tidx)
-    {
-      if(!device_.hasSensor(types[tidx])) continue;
+    if(!profile_.hardware.empty()) summary << " Hardware: " << profile_.hardware;
+    if(!profile_.firmware.empty()) summary << " Firmware: " << profile_.firmware;
+    if(!profile_.driver.empty()) summary << " Driver: " << profile_.driver;
+
+    ROS_INFO_STREAM(profile_.vendor << " " << profile_.name << summary.str());
+  }
 
-      const SensorInfo* info = device_.getSensorInfo(types[tidx]);
-      ROS_INFO_STREAM("  " << toString(info->getSensorType()));
+  void printVideoModes()
+  {
+    SensorType sensor = SensorType(0);
 
-      const Array<VideoMode>& modes = info->getSupportedVideoModes();
+    for(size_t idx = 0; idx < profile_.modes.size(); ++idx)
+    {
+      const VideoMode& mode = profile_.modes[idx].mode;
 
-      for(int idx = 0; idx < modes.getSize(); ++idx)
+      if(idx == 0 || profile_.modes[idx].sensor != sensor)
       {
-        const VideoMode& mode = modes[idx];
-        ROS_INFO_STREAM("    " << toString(mode.getPixelFormat()) << " " << mode.getResolutionX() << "x" << mode.getResolutionY() << "@" << mode.getFps());
+        sensor = profile_.modes[idx].sensor;
+        ROS_INFO_STREAM("  " << toString(sensor));
       }
+
+      ROS_INFO_STREAM("    " << toString(mode.getPixelFormat()) << " " << mode.getResolutionX() << "x" << mode.getResolutionY() << "@" << mode.getFps());
     }
   }
 
+  /**
+   * Looks the mode up in the profile instead of trying it on the device.
+   */
+  bool isSupported(SensorType sensor, const VideoMode& mode)
+  {
+    boost::mutex::scoped_lock lock(profile_mutex_);
+
+    if(!profile_.knowsSensor(sensor) || profile_.supports(sensor, mode)) return true;
+
+    ROS_ERROR_STREAM("Video mode " << toString(mode.getPixelFormat()) << " " << mode.getResolutionX() << "x" << mode.getResolutionY() << "@" << mode.getFps() << " is not supported by the " << toString(sensor) << " sensor, keeping the current one!");
+
+    return false;
+  }
+
   void createVideoMode(VideoMode& m, int x, int y, int fps, PixelFormat format)
   {
     m.setResolution(x, y);
@@ -562,94 +2456,111 @@ public:
     createVideoMode(resolutions_[Camera_IR_1280x1024_30Hz], 1280, 1024, 30, PIXEL_FORMAT_RGB888);
   }
 
-  void configure(CameraConfig& cfg, uint32_t level)
+  /**
+   * Applies the resolution to the sensor and returns the one it is configured with afterwards, so
+   * the reconfigure server shows a rejected resolution reverted.
+   */
+  int configureResolution(SensorType sensor, SensorStreamManagerBase& manager, int resolution)
   {
-    if(rgb_sensor_->beginConfigure())
-    {
-      if((level & 8) != 0)
-      {
-        ResolutionMap::iterator e = resolutions_.find(cfg.rgb_resolution);
-        assert(e != resolutions_.end());
+    ResolutionMap::iterator e = resolutions_.find(resolution);
+    assert(e != resolutions_.end());
 
-        rgb_sensor_->tryConfigureVideoMode(e->second);
-      }
+    if(!isSupported(sensor, e->second)) return resolution;
 
-      if((level & 2) != 0)
-      {
-        rgb_sensor_->stream().getCameraSettings()->setAutoExposureEnabled(cfg.auto_exposure);
-      }
+    VideoMode mode = manager.configureVideoMode(e->second);
 
-      if((level & 4) != 0)
-      {
-        rgb_sensor_->stream().getCameraSettings()->setAutoWhiteBalanceEnabled(cfg.auto_white_balance);
-      }
+    if(isSameVideoMode(mode, e->second)) return resolution;
 
-      if((level & 64) != 0)
-      {
-        rgb_sensor_->stream().setMirroringEnabled(cfg.mirror);
-      }
-      rgb_sensor_->endConfigure();
+    for(ResolutionMap::const_iterator it = resolutions_.begin(); it != resolutions_.end(); ++it)
+    {
+      if(isSameVideoMode(it->second, mode)) return it->first;
     }
 
-    if(depth_sensor_->beginConfigure())
+    return resolution;
+  }
+
+  /**
+   * level tells which parameters changed, the sensors compare against their current settings.
+   * Only a changed video mode stops a stream, everything else is applied while streaming.
+   */
+  void configure(CameraConfig& cfg, uint32_t level)
+  {
+    if((level & 128) != 0)
     {
-      if((level & 16) != 0)
-      {
-        ResolutionMap::iterator e = resolutions_.find(cfg.depth_resolution);
-        assert(e != resolutions_.end());
+      rgb_sensor_->configureThrottle(cfg.rgb_data_skip, cfg.rgb_max_rate);
+      depth_sensor_->configureThrottle(cfg.depth_data_skip, cfg.depth_max_rate);
+      ir_sensor_->configureThrottle(cfg.ir_data_skip, cfg.ir_max_rate);
+    }
 
-        depth_sensor_->tryConfigureVideoMode(e->second);
-      }
+    if((level & 256) != 0)
+    {
+      rgb_sensor_->configureLingerTime(cfg.linger_time);
+      depth_sensor_->configureLingerTime(cfg.linger_time);
+      ir_sensor_->configureLingerTime(cfg.linger_time);
+    }
 
-      if((level & 1) != 0)
-      {
-        if(cfg.depth_registration)
-        {
-          if(device_.isImageRegistrationModeSupported(IMAGE_REGISTRATION_DEPTH_TO_COLOR))
-          {
-            device_.setImageRegistrationMode(IMAGE_REGISTRATION_DEPTH_TO_COLOR);
-          }
-          else
-          {
-            cfg.depth_registration = false;
-          }
-        }
-        else
-        {
-          device_.setImageRegistrationMode(IMAGE_REGISTRATION_OFF);
-        }
-      }
+    if((level & 8) != 0)
+    {
+      cfg.rgb_resolution = configureResolution(SENSOR_COLOR, *rgb_sensor_, cfg.rgb_resolution);
+    }
 
-      if((level & 64) != 0)
-      {
-        depth_sensor_->stream().setMirroringEnabled(cfg.mirror);
-      }
+    if((level & 16) != 0)
+    {
+      cfg.depth_resolution = configureResolution(SENSOR_DEPTH, *depth_sensor_, cfg.depth_resolution);
+    }
+
+    if((level & 32) != 0)
+    {
+      cfg.ir_resolution = configureResolution(SENSOR_IR, *ir_sensor_, cfg.ir_resolution);
+    }
+
+    if((level & 2) != 0)
+    {
+      rgb_sensor_->configureAutoExposure(cfg.auto_exposure);
+    }
 
-      depth_sensor_->endConfigure();
+    if((level & 4) != 0)
+    {
+      rgb_sensor_->configureAutoWhiteBalance(cfg.auto_white_balance);
     }
 
+    if((level & 64) != 0)
+    {
+      rgb_sensor_->configureMirroring(cfg.mirror);
+      depth_sensor_->configureMirroring(cfg.mirror);
+      ir_sensor_->configureMirroring(cfg.mirror);
+    }
 
-    if(ir_sensor_->beginConfigure())
+    if((level & 1) != 0)
     {
-      if((level & 32) != 0)
+      bool registration_supported;
+
       {
-        ResolutionMap::iterator e = resolutions_.find(cfg.ir_resolution);
-        assert(e != resolutions_.end());
+        boost::mutex::scoped_lock lock(profile_mutex_);
 
-        ir_sensor_->tryConfigureVideoMode(e->second);
+        // the device decides once it is opened
+        registration_supported = !profile_loaded_ || profile_.registration_supported;
       }
 
-      if((level & 64) != 0)
+      if(cfg.depth_registration && !registration_supported)
       {
-        ir_sensor_->stream().setMirroringEnabled(cfg.mirror);
+        cfg.depth_registration = false;
       }
 
-      ir_sensor_->endConfigure();
+      if(!depth_sensor_->configureRegistration(cfg.depth_registration))
+      {
+        cfg.depth_registration = false;
+      }
     }
 
-    device_.setDepthColorSyncEnabled(true);
+    boost::mutex::scoped_lock lock(device_mutex_);
+
+    if(connected_) device_.setDepthColorSyncEnabled(true);
   }
 private:
+  // destroyed after the sensors, which remove their streams from it
+  boost::scoped_ptr<FramePoller> poller_;
+  boost::shared_ptr<DeviceClockEstimator> clock_;
   boost::shared_ptr<SensorStreamManagerBase> rgb_sensor_, depth_sensor_, ir_sensor_;
   dynamic_reconfigure::Server<CameraConfig> reconfigure_server_;
 
@@ -658,13 +2569,46 @@ private:
   ResolutionMap resolutions_;
 
   Device device_;
+
+  // serializes losing and reopening the device with each other and with device wide settings
+  boost::mutex device_mutex_;
+  std::string uri_, serial_;
+  bool connected_;
+  ros::WallTime disconnect_time_;
+  int usb_interface_;
+
+  // written when the device is first opened, which may be after reconfiguration started
+  boost::mutex profile_mutex_;
+  DeviceProfile profile_;
+  bool profile_loaded_;
+  std::string profile_cache_;
+
+  ros::Publisher clock_publisher_;
+  ros::WallTimer clock_timer_;
+  ros::ServiceServer frameset_service_;
+
+  boost::mutex recording_mutex_;
+  boost::scoped_ptr<Recorder> recorder_;
+  std::string recording_file_;
+  ros::ServiceServer start_recording_service_, stop_recording_service_;
+
+  boost::shared_ptr<FrameLogQueue> frame_log_;
+  boost::shared_ptr<PreTriggerRing> pre_trigger_ring_;
+  ros::ServiceServer dump_frames_service_;
+
+  boost::shared_ptr<BenchmarkGate> benchmark_gate_;
+  ros::Subscriber benchmark_ack_subscriber_;
+
+  // only set when replaying a recording
+  PlaybackControl* playback_;
+  ros::ServiceServer set_playback_service_, seek_playback_service_;
 };
 
 
 } /* namespace internal */
 
-Camera::Camera(ros::NodeHandle& nh, ros::NodeHandle& nh_private, const openni::DeviceInfo& device_info) :
-    impl_(new internal::CameraImpl(nh, nh_private, device_info))
+Camera::Camera(ros::NodeHandle& nh, ros::NodeHandle& nh_private, const openni::DeviceInfo& device_info, const boost::shared_ptr<FrameWorkerPool>& pool) :
+    impl_(new internal::CameraImpl(nh, nh_private, device_info, pool))
 {
 }
 
@@ -673,4 +2617,29 @@ Camera::~Camera()
   delete impl_;
 }
 
+std::string Camera::serial() const
+{
+  return impl_->serial();
+}
+
+std::string Camera::uri() const
+{
+  return impl_->uri();
+}
+
+bool Camera::isConnected() const
+{
+  return impl_->isConnected();
+}
+
+void Camera::disconnect()
+{
+  impl_->disconnect();
+}
+
+bool Camera::reconnect(const openni::DeviceInfo& device_info)
+{
+  return impl_->reconnect(device_info);
+}
+
 } /* namespace openni2_camera */
@@ -22,50 +22,260 @@
  */
 
 #include <openni2_camera/camera_factory.h>
+#include <openni2_camera/device_index.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
 
 namespace openni2_camera
 {
 
+namespace internal
+{
+
+/**
+ * Recordings are selected by their path, which either ends in .oni or names an existing file.
+ */
+bool isRecording(const std::string& device_id)
+{
+  static const std::string extension = ".oni";
+
+  if(device_id.size() > extension.size() && device_id.compare(device_id.size() - extension.size(), extension.size(), extension) == 0) return true;
+
+  struct stat info;
+
+  return ::stat(device_id.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+}
+
+bool readRecordingInfo(const std::string& file, openni::DeviceInfo& device_info)
+{
+  openni::Device device;
+
+  if(device.open(file.c_str()) != openni::STATUS_OK) return false;
+
+  device_info = device.getDeviceInfo();
+  device.close();
+
+  return true;
+}
+
+} /* namespace internal */
+
 CameraFactory::CameraFactory() :
-  camera_(0)
+  runtime_(OpenNIRuntime::acquire()),
+  device_connected_(false),
+  shutdown_(false),
+  reconnect_interval_(1.0)
 {
-  initialized_ = (openni::OpenNI::initialize() == openni::STATUS_OK);
+  if(!runtime_->isInitialized()) return;
 
-  ROS_ERROR_COND(!initialized_, "OpenNI2 initialization failed!");
+  openni::OpenNI::addDeviceConnectedListener(this);
+  openni::OpenNI::addDeviceDisconnectedListener(this);
+  openni::OpenNI::addDeviceStateChangedListener(this);
+
+  reconnect_thread_ = boost::thread(&CameraFactory::reconnectLoop, this);
 }
 
 CameraFactory::~CameraFactory()
 {
-  if(camera_ != 0) delete camera_;
+  if(runtime_->isInitialized())
+  {
+    openni::OpenNI::removeDeviceConnectedListener(this);
+    openni::OpenNI::removeDeviceDisconnectedListener(this);
+    openni::OpenNI::removeDeviceStateChangedListener(this);
+  }
 
-  openni::OpenNI::shutdown();
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    shutdown_ = true;
+    condition_.notify_one();
+  }
+
+  if(reconnect_thread_.joinable()) reconnect_thread_.join();
+
+  for(size_t idx = 0; idx < cameras_.size(); ++idx)
+  {
+    std::string uri = cameras_[idx]->uri();
+
+    delete cameras_[idx];
+    runtime_->releaseDevice(uri);
+  }
+}
+
+void CameraFactory::onDeviceConnected(const openni::DeviceInfo* device_info)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  device_connected_ = true;
+  condition_.notify_one();
+}
+
+void CameraFactory::onDeviceDisconnected(const openni::DeviceInfo* device_info)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  lost_uris_.push_back(device_info->getUri());
+  condition_.notify_one();
+}
+
+void CameraFactory::onDeviceStateChanged(const openni::DeviceInfo* device_info, openni::DeviceState state)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  if(state == openni::DEVICE_STATE_OK)
+  {
+    device_connected_ = true;
+  }
+  // recordings without repeat stay at their end, the device is not lost
+  else if(state != openni::DEVICE_STATE_EOF)
+  {
+    lost_uris_.push_back(device_info->getUri());
+  }
+
+  condition_.notify_one();
+}
+
+/**
+ * OpenNI calls the listeners from its own thread, which must not block on opening devices, so the
+ * events are handled here.
+ */
+void CameraFactory::reconnectLoop()
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+
+  while(true)
+  {
+    bool any_lost = false;
+
+    for(size_t idx = 0; idx < cameras_.size(); ++idx)
+    {
+      any_lost = any_lost || !cameras_[idx]->isConnected();
+    }
+
+    if(!shutdown_ && lost_uris_.empty() && !device_connected_)
+    {
+      if(any_lost)
+      {
+        condition_.timed_wait(lock, boost::posix_time::milliseconds(int64_t(reconnect_interval_ * 1000.0)));
+      }
+      else
+      {
+        condition_.wait(lock);
+      }
+    }
+
+    if(shutdown_) break;
+
+    std::deque<std::string> lost_uris;
+    lost_uris.swap(lost_uris_);
+    device_connected_ = false;
+
+    // cameras are only removed after this thread stopped
+    std::vector<Camera*> cameras = cameras_;
+    std::string cache_file = cache_file_;
+
+    lock.unlock();
+
+    for(size_t idx = 0; idx < cameras.size(); ++idx)
+    {
+      Camera& camera = *cameras[idx];
+      std::string uri = camera.uri();
+
+      if(camera.isConnected() && std::find(lost_uris.begin(), lost_uris.end(), uri) != lost_uris.end())
+      {
+        ROS_WARN_STREAM("Lost device '" << camera.serial() << "' at '" << uri << "'.");
+
+        camera.disconnect();
+        runtime_->releaseDevice(uri);
+      }
+
+      if(!camera.isConnected()) reconnect(camera, cache_file);
+    }
+
+    lock.lock();
+  }
+}
+
+bool CameraFactory::reconnect(Camera& camera, const std::string& cache_file)
+{
+  DeviceIndex index(cache_file);
+  index.update();
+
+  openni::DeviceInfo device_info;
+
+  std::string serial = camera.serial();
+
+  if(serial.empty())
+  {
+    // without a serial number only the same device at the same port can be identified
+    if(!index.findByUri(camera.uri(), device_info)) return false;
+  }
+  else if(!index.findBySerial(serial, runtime_->claimedDevices(), device_info))
+  {
+    return false;
+  }
+
+  if(!runtime_->claimDevice(device_info.getUri())) return false;
+
+  if(!camera.reconnect(device_info))
+  {
+    runtime_->releaseDevice(device_info.getUri());
+    return false;
+  }
+
+  return true;
 }
 
 bool CameraFactory::create(ros::NodeHandle& nh, ros::NodeHandle& nh_private, const std::string& device_id_default)
 {
   bool success = false;
 
-  openni::Array<openni::DeviceInfo> devices;
-  openni::OpenNI::enumerateDevices(&devices);
+  if(!runtime_->isInitialized()) return false;
+
+  std::string cache_file, cache_directory = cacheDirectory();
+  nh_private.param("device_index_cache", cache_file, cache_directory.empty() ? std::string() : cache_directory + "/device_index");
+
+  double reconnect_interval;
+  nh_private.param("reconnect_interval", reconnect_interval, 1.0);
 
   openni::DeviceInfo used_device;
   std::string device_id;
 
-  int device_count = devices.getSize();
+  //select the desired device via the device_id parameter of the .launch file
+  if(!nh_private.getParam("device_id", device_id)) {
+    ROS_WARN("parameter ~device_id is not set! Using default value %s.", device_id_default.c_str());
+    device_id = device_id_default;
+  }
+  else
+  {
+    ROS_INFO("openni2_camera using parameter device_id = %s", device_id.c_str());
+  }
 
-  if(device_count > 0)
+  //device_id is the path of a recording, which needs no camera
+  if (internal::isRecording(device_id))
   {
-    ROS_INFO("openni2 detected %d cameras.", device_count);
-    //select the desired device via the device_id parameter of the .launch file
-    if(!nh_private.getParam("device_id", device_id)) {
-      ROS_WARN("parameter ~device_id is not set! Using default value %s.", device_id_default.c_str());
-      device_id = device_id_default;
-    }
-    else
+    ROS_INFO("Using recording '%s'", device_id.c_str());
+
+    success = internal::readRecordingInfo(device_id, used_device);
+
+    ROS_ERROR_COND(!success, "Failed to open recording '%s': %s", device_id.c_str(), openni::OpenNI::getExtendedError());
+  }
+  else
+  {
+    DeviceIndex index(cache_file);
+    index.update();
+
+    int device_count = int(index.devices().size());
+
+    if(device_count == 0)
     {
-      ROS_INFO("openni2_camera using parameter device_id = %s", device_id.c_str());
+      ROS_ERROR("OpenNI2 found no devices!");
+      return false;
     }
 
+    ROS_INFO("openni2 detected %d cameras.", device_count);
+
     //device_id is given in usb bus@address format
     if (device_id.find ('@') != std::string::npos)
     {
@@ -74,20 +284,21 @@ bool CameraFactory::create(ros::NodeHandle& nh, ros::NodeHandle& nh_private, con
       unsigned address = atoi(device_id.substr(at_pos+1, device_id.length()-at_pos-1).c_str());
       ROS_INFO ("Using camera device at bus@address = %d@%d", bus, address);
 
-      //TODO: implement function for getting device by address..
-      //used_device = device_by_address(bus, address);
+      success = index.findByBusAddress(bus, address, used_device);
+
+      ROS_ERROR_COND(!success, "No device found at bus@address = %d@%d.", bus, address);
     }
     //device is given in #index format
     else if (device_id[0] == '#')
     {
       int dev_index = atoi(device_id.c_str() + 1);
 
-      if(dev_index > device_count) {
+      if(dev_index < 1 || dev_index > device_count) {
         ROS_ERROR("You selected device #%d, but only %d are present.", dev_index, device_count);
         return false;
       }
       ROS_INFO ("Using camera device at index = #%d", dev_index);
-      used_device = devices[dev_index - 1];
+      used_device = index.devices()[dev_index - 1];
       success = true;
     }
     //device should be selected by its serial number
@@ -95,17 +306,37 @@ bool CameraFactory::create(ros::NodeHandle& nh, ros::NodeHandle& nh_private, con
     {
       ROS_INFO("Using device with serial number '%s'", device_id.c_str());
 
-      used_device = devices[0];
-      //TODO: implement function for getting device by address..
-      //used_device = device_by_serial(device_id);
-    }
+      success = index.findBySerial(device_id, runtime_->claimedDevices(), used_device);
 
-    if(success) {
-      camera_ = new openni2_camera::Camera(nh, nh_private, used_device);
+      ROS_ERROR_COND(!success, "No device with serial number '%s' found.", device_id.c_str());
     }
   }
-  else {
-    ROS_ERROR("OpenNI2 found no devices!");
+
+  if(success && !runtime_->claimDevice(used_device.getUri()))
+  {
+    ROS_ERROR("Device '%s' is already opened by another camera in this process.", used_device.getUri());
+    return false;
+  }
+
+  if(success) {
+    int pool_threads;
+    nh_private.param("processing_pool_threads", pool_threads, 0);
+
+    if(pool_threads > 0 && !pool_)
+    {
+      pool_ = FrameWorkerPool::shared(ThreadOptions::fromParameters(nh_private, "processing_pool", "openni2_pool"), size_t(pool_threads));
+    }
+
+    Camera* camera = new openni2_camera::Camera(nh, nh_private, used_device, pool_);
+
+    // a device which could not be opened keeps its topics and is reopened like a lost one
+    if(!camera->isConnected()) runtime_->releaseDevice(used_device.getUri());
+
+    boost::mutex::scoped_lock lock(mutex_);
+    cameras_.push_back(camera);
+    reconnect_interval_ = std::max(reconnect_interval, 0.01);
+    cache_file_ = cache_file;
+    condition_.notify_all();
   }
 
   return success;
@@ -22,20 +22,54 @@
  */
 
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 #include <openni2_camera/camera_factory.h>
 
+#include <algorithm>
+
+/**
+ * Callbacks are split into queues with their own spinner threads, so a slow reconfiguration
+ * does not delay subscriber connects or the other way round:
+ *   control:      dynamic reconfigure, which may restart streams (~control_threads)
+ *   subscription: subscriber connects and disconnects, camera info, clock and frameset services
+ *                 of the camera namespace (~subscription_threads)
+ *   global:       everything else (~threads)
+ * Frames are published from the OpenNI or processing threads and do not wait for any queue.
+ */
 int main(int argc, char **argv)
 {
   ros::init(argc, argv, "camera_node");
 
+  ros::CallbackQueue control_queue, subscription_queue;
+
   ros::NodeHandle nh("camera");
   ros::NodeHandle nh_private("~");
 
+  nh.setCallbackQueue(&subscription_queue);
+  nh_private.setCallbackQueue(&control_queue);
+
+  int control_threads, subscription_threads, threads;
+  nh_private.param("control_threads", control_threads, 1);
+  nh_private.param("subscription_threads", subscription_threads, 1);
+  nh_private.param("threads", threads, 1);
+
+  ros::AsyncSpinner control_spinner(uint32_t(std::max(control_threads, 1)), &control_queue);
+  ros::AsyncSpinner subscription_spinner(uint32_t(std::max(subscription_threads, 1)), &subscription_queue);
+  ros::AsyncSpinner spinner(uint32_t(std::max(threads, 1)));
+
   openni2_camera::CameraFactory camera_factory;
 
   if(camera_factory.create(nh, nh_private, "#1"))
   {
-    ros::spin();
+    control_spinner.start();
+    subscription_spinner.start();
+    spinner.start();
+
+    ros::waitForShutdown();
+
+    spinner.stop();
+    subscription_spinner.stop();
+    control_spinner.stop();
   }
   else
   {
@@ -0,0 +1,272 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/image_encodings.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <openni2_camera/rvl_image_transport.h>
+
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+#include <iomanip>
+#include <cmath>
+
+namespace openni2_camera
+{
+
+struct CodecStatistics
+{
+  std::string name;
+  size_t frames, raw_bytes, encoded_bytes, mismatches, valid_pixels;
+  double encode_time, decode_time, squared_error, max_error;
+
+  CodecStatistics(const std::string& codec_name) :
+    name(codec_name),
+    frames(0),
+    raw_bytes(0),
+    encoded_bytes(0),
+    mismatches(0),
+    valid_pixels(0),
+    encode_time(0.0),
+    decode_time(0.0),
+    squared_error(0.0),
+    max_error(0.0)
+  {
+  }
+
+  void print(std::ostream& out) const
+  {
+    double n = std::max<double>(frames, 1);
+
+    out << std::setw(12) << name
+        << std::setw(10) << frames
+        << std::setw(12) << std::fixed << std::setprecision(2) << double(raw_bytes) / std::max<double>(encoded_bytes, 1)
+        << std::setw(14) << std::setprecision(1) << encoded_bytes / n / 1024.0
+        << std::setw(12) << std::setprecision(3) << encode_time / n * 1000.0
+        << std::setw(12) << std::setprecision(3) << decode_time / n * 1000.0
+        << std::setw(12) << mismatches
+        << std::setw(10) << std::setprecision(2) << std::sqrt(squared_error / std::max<double>(valid_pixels, 1))
+        << std::setw(10) << std::setprecision(0) << max_error
+        << std::endl;
+  }
+};
+
+bool samePixels(const sensor_msgs::Image& a, const cv::Mat& b)
+{
+  if(int(a.height) != b.rows || int(a.width) != b.cols) return false;
+
+  for(uint32_t y = 0; y < a.height; ++y)
+  {
+    if(!std::equal(&a.data[y * a.step], &a.data[y * a.step] + a.width * sizeof(uint16_t), b.ptr<uint8_t>(y))) return false;
+  }
+
+  return true;
+}
+
+void accumulateError(const sensor_msgs::Image& original, const sensor_msgs::Image& decoded, CodecStatistics& stats)
+{
+  if(original.width != decoded.width || original.height != decoded.height)
+  {
+    stats.mismatches += 1;
+    return;
+  }
+
+  for(uint32_t y = 0; y < original.height; ++y)
+  {
+    const uint16_t* a = reinterpret_cast<const uint16_t*>(&original.data[y * original.step]);
+    const uint16_t* b = reinterpret_cast<const uint16_t*>(&decoded.data[y * decoded.step]);
+
+    for(uint32_t x = 0; x < original.width; ++x)
+    {
+      // invalid pixels have to stay invalid, valid ones contribute to the error
+      if((a[x] == 0) != (b[x] == 0))
+      {
+        stats.mismatches += 1;
+        return;
+      }
+
+      if(a[x] == 0) continue;
+
+      double error = std::abs(double(a[x]) - double(b[x]));
+      stats.squared_error += error * error;
+      stats.max_error = std::max(stats.max_error, error);
+      stats.valid_pixels += 1;
+    }
+  }
+}
+
+void benchmarkRvl(const sensor_msgs::Image& image, CodecStatistics& stats)
+{
+  sensor_msgs::CompressedImage compressed;
+  sensor_msgs::Image decoded;
+
+  ros::WallTime t0 = ros::WallTime::now();
+  encodeRvlImage(image, compressed);
+  ros::WallTime t1 = ros::WallTime::now();
+  bool ok = decodeRvlImage(compressed, decoded);
+  ros::WallTime t2 = ros::WallTime::now();
+
+  stats.frames += 1;
+  stats.raw_bytes += image.width * image.height * sizeof(uint16_t);
+  stats.encoded_bytes += compressed.data.size();
+  stats.encode_time += (t1 - t0).toSec();
+  stats.decode_time += (t2 - t1).toSec();
+
+  if(!ok || !samePixels(image, cv::Mat(decoded.height, decoded.width, CV_16UC1, &decoded.data[0], decoded.step)))
+  {
+    stats.mismatches += 1;
+  }
+}
+
+void benchmarkLossy(const sensor_msgs::Image& image, CodecStatistics& stats, const DepthQuantizer& quantizer)
+{
+  sensor_msgs::CompressedImage compressed;
+  sensor_msgs::Image decoded;
+  boost::scoped_ptr<DepthQuantizer> decoder_quantizer;
+
+  // let the decoder build its tables outside of the timed section, like a long running subscriber
+  encodeLossyDepthImage(image, quantizer, compressed);
+  decodeLossyDepthImage(compressed, decoder_quantizer, decoded);
+
+  ros::WallTime t0 = ros::WallTime::now();
+  encodeLossyDepthImage(image, quantizer, compressed);
+  ros::WallTime t1 = ros::WallTime::now();
+  bool ok = decodeLossyDepthImage(compressed, decoder_quantizer, decoded);
+  ros::WallTime t2 = ros::WallTime::now();
+
+  stats.frames += 1;
+  stats.raw_bytes += image.width * image.height * sizeof(uint16_t);
+  stats.encoded_bytes += compressed.data.size();
+  stats.encode_time += (t1 - t0).toSec();
+  stats.decode_time += (t2 - t1).toSec();
+
+  if(ok)
+  {
+    accumulateError(image, decoded, stats);
+  }
+  else
+  {
+    stats.mismatches += 1;
+  }
+}
+
+void benchmarkPng(const sensor_msgs::Image& image, int level, CodecStatistics& stats)
+{
+  cv::Mat mat(image.height, image.width, CV_16UC1, const_cast<uint8_t*>(&image.data[0]), image.step);
+  std::vector<uint8_t> compressed;
+  std::vector<int> params;
+  params.push_back(CV_IMWRITE_PNG_COMPRESSION);
+  params.push_back(level);
+
+  ros::WallTime t0 = ros::WallTime::now();
+  cv::imencode(".png", mat, compressed, params);
+  ros::WallTime t1 = ros::WallTime::now();
+  cv::Mat decoded = cv::imdecode(compressed, CV_LOAD_IMAGE_UNCHANGED);
+  ros::WallTime t2 = ros::WallTime::now();
+
+  stats.frames += 1;
+  stats.raw_bytes += image.width * image.height * sizeof(uint16_t);
+  stats.encoded_bytes += compressed.size();
+  stats.encode_time += (t1 - t0).toSec();
+  stats.decode_time += (t2 - t1).toSec();
+
+  if(!samePixels(image, decoded))
+  {
+    stats.mismatches += 1;
+  }
+}
+
+} /* namespace openni2_camera */
+
+int main(int argc, char **argv)
+{
+  using namespace openni2_camera;
+  namespace enc = sensor_msgs::image_encodings;
+
+  if(argc < 3)
+  {
+    std::cerr << "Usage: depth_codec_benchmark <bag> <depth topic> [<depth topic> ...]" << std::endl;
+    return 1;
+  }
+
+  ros::Time::init();
+
+  std::vector<std::string> topics(argv + 2, argv + argc);
+
+  rosbag::Bag bag;
+  bag.open(argv[1], rosbag::bagmode::Read);
+  rosbag::View view(bag, rosbag::TopicQuery(topics));
+
+  CodecStatistics rvl("rvl"), png1("png(1)"), png9("png(9)");
+
+  static const size_t nscales = 4;
+  float error_scales[nscales] = { 0.25f, 0.5f, 1.0f, 2.0f };
+  std::vector<DepthQuantizer> quantizers;
+  std::vector<CodecStatistics> lossy;
+
+  for(size_t idx = 0; idx < nscales; ++idx)
+  {
+    quantizers.push_back(DepthQuantizer(error_scales[idx]));
+    lossy.push_back(CodecStatistics("lossy(" + boost::lexical_cast<std::string>(error_scales[idx]) + ")"));
+  }
+
+  BOOST_FOREACH(const rosbag::MessageInstance& m, view)
+  {
+    sensor_msgs::Image::ConstPtr image = m.instantiate<sensor_msgs::Image>();
+
+    if(!image || (image->encoding != enc::TYPE_16UC1 && image->encoding != enc::MONO16) || image->data.empty()) continue;
+
+    benchmarkRvl(*image, rvl);
+    benchmarkPng(*image, 1, png1);
+    benchmarkPng(*image, 9, png9);
+
+    if(image->encoding != enc::TYPE_16UC1) continue;
+
+    for(size_t idx = 0; idx < nscales; ++idx)
+    {
+      benchmarkLossy(*image, lossy[idx], quantizers[idx]);
+    }
+  }
+
+  bag.close();
+
+  std::cout << std::setw(12) << "codec" << std::setw(10) << "frames" << std::setw(12) << "ratio" << std::setw(14) << "KiB/frame"
+            << std::setw(12) << "enc ms" << std::setw(12) << "dec ms" << std::setw(12) << "mismatches"
+            << std::setw(10) << "rmse mm" << std::setw(10) << "max mm" << std::endl;
+  rvl.print(std::cout);
+  png1.print(std::cout);
+  png9.print(std::cout);
+
+  for(size_t idx = 0; idx < nscales; ++idx)
+  {
+    lossy[idx].print(std::cout);
+  }
+
+  return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <openni2_camera/depth_quantizer.h>
+
+#include <boost/math/special_functions/fpclassify.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace openni2_camera
+{
+
+const float DepthQuantizer::DEFAULT_NOISE_COEFFICIENT = 1.425e-6f;
+const float DepthQuantizer::MAX_ERROR_SCALE = 1000.0f;
+const float DepthQuantizer::MAX_ERROR = 65535.0f;
+const float DepthQuantizer::MAX_NOISE_COEFFICIENT = 1.0f;
+
+bool DepthQuantizer::isValid(float error_scale, float max_error, float noise_coefficient)
+{
+  return boost::math::isfinite(error_scale) && boost::math::isfinite(max_error) && boost::math::isfinite(noise_coefficient) &&
+      error_scale >= 0.0f && error_scale <= MAX_ERROR_SCALE &&
+      max_error >= 0.0f && max_error <= MAX_ERROR &&
+      noise_coefficient >= 0.0f && noise_coefficient <= MAX_NOISE_COEFFICIENT;
+}
+
+DepthQuantizer::DepthQuantizer(float error_scale, float max_error, float noise_coefficient) :
+  error_scale_(error_scale),
+  max_error_(max_error),
+  noise_coefficient_(noise_coefficient),
+  codes_(0x10000),
+  depths_(1, 0)
+{
+  // code 0 is reserved for invalid depth, every following code covers the bin [lo, lo + 2e]
+  // and reconstructs to lo + e, where e is the error bound at the lower end of the bin
+  codes_[0] = 0;
+
+  uint32_t lo = 1;
+
+  while(lo <= 0xFFFF)
+  {
+    // clamped, so NaN or huge bounds neither overflow the conversion nor lo + 2 * e
+    float bound = errorBound(uint16_t(lo));
+    uint32_t e = bound > 0.0f ? (bound < MAX_ERROR ? uint32_t(std::floor(bound)) : 0xFFFF) : 0;
+    uint32_t hi = std::min<uint32_t>(lo + 2 * e, 0xFFFF);
+    uint16_t code = uint16_t(depths_.size());
+
+    std::fill(codes_.begin() + lo, codes_.begin() + hi + 1, code);
+    depths_.push_back(uint16_t(std::min<uint32_t>(lo + e, hi)));
+
+    lo = hi + 1;
+  }
+}
+
+float DepthQuantizer::errorBound(uint16_t depth) const
+{
+  float z = float(depth);
+  float bound = std::max(error_scale_, 0.0f) * noise_coefficient_ * z * z;
+
+  return max_error_ > 0.0f ? std::min(bound, max_error_) : bound;
+}
+
+bool DepthQuantizer::hasSameParameters(float error_scale, float max_error, float noise_coefficient) const
+{
+  return error_scale_ == error_scale && max_error_ == max_error && noise_coefficient_ == noise_coefficient;
+}
+
+void DepthQuantizer::quantize(const uint16_t* depth, size_t num_pixels, uint16_t* codes) const
+{
+  const uint16_t* table = &codes_[0];
+
+  for(size_t idx = 0; idx < num_pixels; ++idx)
+  {
+    codes[idx] = table[depth[idx]];
+  }
+}
+
+void DepthQuantizer::dequantize(const uint16_t* codes, size_t num_pixels, uint16_t* depth) const
+{
+  const uint16_t* table = &depths_[0];
+  uint16_t max_code = uint16_t(depths_.size() - 1);
+
+  for(size_t idx = 0; idx < num_pixels; ++idx)
+  {
+    depth[idx] = table[std::min(codes[idx], max_code)];
+  }
+}
+
+} /* namespace openni2_camera */
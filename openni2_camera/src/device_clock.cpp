@@ -0,0 +1,363 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <openni2_camera/device_clock.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace openni2_camera
+{
+
+namespace internal
+{
+
+// device timestamps jumping back further restart the estimate, e.g. after reconnecting
+static const double CLOCK_RESET_THRESHOLD = 1.0;
+
+static const double JITTER_SMOOTHING = 0.05;
+
+} /* namespace internal */
+
+DeviceClockEstimator::DeviceClockEstimator(size_t window) :
+  window_(std::max<size_t>(window, 2)),
+  has_origin_(false),
+  device_origin_(0),
+  last_device_timestamp_(0),
+  valid_(false),
+  intercept_(0.0),
+  slope_(0.0),
+  jitter_(0.0),
+  samples_(0),
+  playback_(false)
+{
+}
+
+void DeviceClockEstimator::reset(uint64_t device_timestamp, const ros::Time& arrival)
+{
+  has_origin_ = true;
+  device_origin_ = device_timestamp;
+  host_origin_ = arrival;
+  buckets_.clear();
+  valid_ = playback_;
+  intercept_ = 0.0;
+  slope_ = 0.0;
+  jitter_ = 0.0;
+  samples_ = 0;
+}
+
+void DeviceClockEstimator::update(uint64_t device_timestamp, const ros::Time& arrival)
+{
+  // the estimate only needs the earliest arrival per second, losing a sample costs nothing
+  boost::mutex::scoped_try_lock lock(mutex_);
+
+  if(!lock.owns_lock()) return;
+
+  if(!has_origin_ || double(last_device_timestamp_) - double(device_timestamp) > internal::CLOCK_RESET_THRESHOLD * 1e6)
+  {
+    reset(device_timestamp, arrival);
+  }
+
+  last_device_timestamp_ = device_timestamp;
+  ++samples_;
+
+  if(playback_) return;
+
+  // relative to the origin, so double precision suffices for years
+  double device_time = (double(device_timestamp) - double(device_origin_)) * 1e-6;
+  double delay = (arrival - host_origin_).toSec() - device_time;
+  int64_t index = int64_t(std::floor(device_time));
+
+  if(valid_)
+  {
+    jitter_ += internal::JITTER_SMOOTHING * (delay - intercept_ - slope_ * device_time - jitter_);
+  }
+
+  if(!buckets_.empty() && buckets_.back().index == index)
+  {
+    Bucket& bucket = buckets_.back();
+
+    if(delay < bucket.delay)
+    {
+      bucket.delay = delay;
+      bucket.device_time = device_time;
+    }
+
+    return;
+  }
+
+  // a second of device time is complete
+  if(buckets_.size() >= 2) fit();
+
+  Bucket bucket;
+  bucket.index = index;
+  bucket.device_time = device_time;
+  bucket.delay = delay;
+  buckets_.push_back(bucket);
+
+  while(buckets_.size() > window_) buckets_.pop_front();
+}
+
+void DeviceClockEstimator::setPlayback(bool playback)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  playback_ = playback;
+  has_origin_ = false;
+  valid_ = false;
+}
+
+void DeviceClockEstimator::restart()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  has_origin_ = false;
+}
+
+void DeviceClockEstimator::fit()
+{
+  // the last bucket is still filling up
+  size_t n = buckets_.size() - 1;
+  double mean_t = 0.0, mean_d = 0.0;
+
+  for(size_t idx = 0; idx < n; ++idx)
+  {
+    mean_t += buckets_[idx].device_time;
+    mean_d += buckets_[idx].delay;
+  }
+
+  mean_t /= n;
+  mean_d /= n;
+
+  double sxx = 0.0, sxy = 0.0;
+
+  for(size_t idx = 0; idx < n; ++idx)
+  {
+    double dt = buckets_[idx].device_time - mean_t;
+    sxx += dt * dt;
+    sxy += dt * (buckets_[idx].delay - mean_d);
+  }
+
+  slope_ = sxx > 0.0 ? sxy / sxx : 0.0;
+  intercept_ = mean_d - slope_ * mean_t;
+
+  double shift = 0.0;
+
+  for(size_t idx = 0; idx < n; ++idx)
+  {
+    shift = std::min(shift, buckets_[idx].delay - intercept_ - slope_ * buckets_[idx].device_time);
+  }
+
+  intercept_ += shift;
+  valid_ = true;
+}
+
+bool DeviceClockEstimator::isValid() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return valid_;
+}
+
+ros::Time DeviceClockEstimator::toHostTime(uint64_t device_timestamp) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  double device_time = (double(device_timestamp) - double(device_origin_)) * 1e-6;
+
+  return host_origin_ + ros::Duration(device_time + intercept_ + slope_ * device_time);
+}
+
+double DeviceClockEstimator::offset() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  double device_time = (double(last_device_timestamp_) - double(device_origin_)) * 1e-6;
+
+  return host_origin_.toSec() - double(device_origin_) * 1e-6 + intercept_ + slope_ * device_time;
+}
+
+double DeviceClockEstimator::drift() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return slope_;
+}
+
+double DeviceClockEstimator::jitter() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return jitter_;
+}
+
+uint64_t DeviceClockEstimator::samples() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return samples_;
+}
+
+FrameHistory::FrameHistory(size_t size) :
+  size_(std::max<size_t>(size, 1))
+{
+}
+
+void FrameHistory::add(const std_msgs::Header& header, const sensor_msgs::ImageConstPtr& image)
+{
+  Frame frame;
+  frame.header = header;
+  frame.image = image;
+
+  boost::mutex::scoped_lock lock(mutex_);
+
+  frames_.push_back(frame);
+
+  while(frames_.size() > size_) frames_.pop_front();
+}
+
+bool FrameHistory::latest(ros::Time& stamp) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  if(frames_.empty()) return false;
+
+  stamp = frames_.back().header.stamp;
+  return true;
+}
+
+bool FrameHistory::nearest(const ros::Time& stamp, std_msgs::Header& header, sensor_msgs::ImageConstPtr& image) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  const Frame* nearest = 0;
+  double nearest_offset = 0.0;
+
+  for(size_t idx = 0; idx < frames_.size(); ++idx)
+  {
+    double offset = std::fabs((frames_[idx].header.stamp - stamp).toSec());
+
+    if(nearest == 0 || offset < nearest_offset)
+    {
+      nearest = &frames_[idx];
+      nearest_offset = offset;
+    }
+  }
+
+  if(nearest == 0) return false;
+
+  header = nearest->header;
+  image = nearest->image;
+  return true;
+}
+
+MultiDeviceClock& MultiDeviceClock::instance()
+{
+  static MultiDeviceClock clock;
+  return clock;
+}
+
+MultiDeviceClock::MultiDeviceClock()
+{
+}
+
+boost::shared_ptr<DeviceClockEstimator> MultiDeviceClock::clock(const std::string& device)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  boost::shared_ptr<DeviceClockEstimator>& result = clocks_[device];
+
+  if(!result) result.reset(new DeviceClockEstimator());
+
+  return result;
+}
+
+void MultiDeviceClock::addStream(const std::string& stream, const boost::shared_ptr<FrameHistory>& history)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  streams_[stream] = history;
+}
+
+void MultiDeviceClock::removeStream(const std::string& stream, const boost::shared_ptr<FrameHistory>& history)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  std::map<std::string, boost::shared_ptr<FrameHistory> >::iterator it = streams_.find(stream);
+
+  if(it != streams_.end() && it->second == history) streams_.erase(it);
+}
+
+bool MultiDeviceClock::getFrameset(GetFrameset::Request& request, GetFrameset::Response& response) const
+{
+  std::map<std::string, boost::shared_ptr<FrameHistory> > streams;
+
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    streams = streams_;
+  }
+
+  std::vector<std::string> names = request.streams;
+
+  if(names.empty())
+  {
+    for(std::map<std::string, boost::shared_ptr<FrameHistory> >::const_iterator it = streams.begin(); it != streams.end(); ++it)
+    {
+      names.push_back(it->first);
+    }
+  }
+
+  ros::Time stamp = request.stamp;
+
+  if(stamp.isZero() && !names.empty())
+  {
+    std::map<std::string, boost::shared_ptr<FrameHistory> >::const_iterator reference = streams.find(names.front());
+
+    if(reference == streams.end() || !reference->second->latest(stamp)) return true;
+  }
+
+  bool any_image = false;
+
+  for(size_t idx = 0; idx < names.size(); ++idx)
+  {
+    std::map<std::string, boost::shared_ptr<FrameHistory> >::const_iterator history = streams.find(names[idx]);
+
+    std_msgs::Header header;
+    sensor_msgs::ImageConstPtr image;
+
+    if(history == streams.end() || !history->second->nearest(stamp, header, image)) continue;
+
+    double offset = (header.stamp - stamp).toSec();
+
+    if(request.max_offset > 0.0 && std::fabs(offset) > request.max_offset) continue;
+
+    response.streams.push_back(names[idx]);
+    response.headers.push_back(header);
+    response.offsets.push_back(offset);
+
+    response.images.push_back(image ? *image : sensor_msgs::Image());
+    any_image = any_image || image;
+  }
+
+  if(!any_image) response.images.clear();
+
+  return true;
+}
+
+} /* namespace openni2_camera */
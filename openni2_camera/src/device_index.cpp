@@ -0,0 +1,301 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <openni2_camera/device_index.h>
+
+#include <ros/console.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace openni2_camera
+{
+
+namespace internal
+{
+
+static const int SERIAL_NUMBER_SIZE = 64;
+
+struct SerialProbe
+{
+  std::string uri, serial;
+  bool success;
+
+  void operator()()
+  {
+    success = DeviceIndex::readSerial(uri, serial);
+  }
+};
+
+} /* namespace internal */
+
+bool parseUsbUri(const std::string& uri, UsbLocation& location)
+{
+  unsigned vendor_id, product_id;
+  char trailing;
+
+  if(std::sscanf(uri.c_str(), "%x/%x@%u/%u%c", &vendor_id, &product_id, &location.bus, &location.address, &trailing) != 4) return false;
+
+  location.vendor_id = uint16_t(vendor_id);
+  location.product_id = uint16_t(product_id);
+
+  return true;
+}
+
+std::string cacheDirectory()
+{
+  std::string directory;
+
+  if(const char* ros_home = std::getenv("ROS_HOME"))
+  {
+    directory = ros_home;
+  }
+  else if(const char* home = std::getenv("HOME"))
+  {
+    directory = std::string(home) + "/.ros";
+  }
+  else
+  {
+    return std::string();
+  }
+
+  directory += "/openni2_camera";
+
+  if(::mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+  {
+    ROS_WARN_STREAM("Failed to create cache directory '" << directory << "'!");
+    return std::string();
+  }
+
+  return directory;
+}
+
+bool replaceFile(const std::string& file, const std::string& content)
+{
+  std::string pattern = file + ".XXXXXX";
+  std::vector<char> tmp_file(pattern.begin(), pattern.end());
+  tmp_file.push_back('\0');
+
+  int fd = ::mkstemp(&tmp_file[0]);
+
+  if(fd < 0) return false;
+
+  // mkstemp creates the file readable by the owner only
+  bool success = ::fchmod(fd, 0644) == 0;
+
+  for(size_t written = 0; success && written < content.size();)
+  {
+    ssize_t result = ::write(fd, content.data() + written, content.size() - written);
+
+    if(result < 0 && errno == EINTR) continue;
+
+    success = result > 0;
+    if(success) written += size_t(result);
+  }
+
+  success = ::close(fd) == 0 && success;
+  success = success && std::rename(&tmp_file[0], file.c_str()) == 0;
+
+  if(!success) ::unlink(&tmp_file[0]);
+
+  return success;
+}
+
+DeviceIndex::DeviceIndex(const std::string& cache_file) :
+  cache_file_(cache_file)
+{
+  load();
+}
+
+void DeviceIndex::update()
+{
+  openni::Array<openni::DeviceInfo> devices;
+  openni::OpenNI::enumerateDevices(&devices);
+
+  devices_.clear();
+
+  for(int idx = 0; idx < devices.getSize(); ++idx)
+  {
+    devices_.push_back(devices[idx]);
+  }
+}
+
+const openni::DeviceInfo* DeviceIndex::findByUri(const std::string& uri) const
+{
+  for(size_t idx = 0; idx < devices_.size(); ++idx)
+  {
+    if(uri == devices_[idx].getUri()) return &devices_[idx];
+  }
+
+  return 0;
+}
+
+bool DeviceIndex::findByUri(const std::string& uri, openni::DeviceInfo& device) const
+{
+  const openni::DeviceInfo* result = findByUri(uri);
+
+  if(result != 0) device = *result;
+
+  return result != 0;
+}
+
+bool DeviceIndex::findByBusAddress(unsigned bus, unsigned address, openni::DeviceInfo& device) const
+{
+  for(size_t idx = 0; idx < devices_.size(); ++idx)
+  {
+    UsbLocation location;
+
+    if(!parseUsbUri(devices_[idx].getUri(), location)) continue;
+
+    if(location.bus == bus && (address == 0 || location.address == address))
+    {
+      device = devices_[idx];
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool DeviceIndex::findBySerial(const std::string& serial, const std::set<std::string>& excluded_uris, openni::DeviceInfo& device)
+{
+  std::map<std::string, std::string>::iterator cached = cache_.find(serial);
+
+  if(cached != cache_.end())
+  {
+    const openni::DeviceInfo* candidate = findByUri(cached->second);
+    std::string candidate_serial;
+
+    if(candidate != 0 && excluded_uris.count(cached->second) == 0 && readSerial(cached->second, candidate_serial) && candidate_serial == serial)
+    {
+      device = *candidate;
+      return true;
+    }
+
+    ROS_DEBUG_STREAM("Cached device index entry for serial '" << serial << "' is outdated.");
+  }
+
+  std::vector<internal::SerialProbe> probes;
+
+  for(size_t idx = 0; idx < devices_.size(); ++idx)
+  {
+    if(excluded_uris.count(devices_[idx].getUri()) > 0) continue;
+
+    internal::SerialProbe probe;
+    probe.uri = devices_[idx].getUri();
+    probe.success = false;
+    probes.push_back(probe);
+  }
+
+  boost::thread_group threads;
+
+  for(size_t idx = 0; idx < probes.size(); ++idx)
+  {
+    threads.create_thread(boost::ref(probes[idx]));
+  }
+
+  threads.join_all();
+
+  bool found = false;
+
+  for(size_t idx = 0; idx < probes.size(); ++idx)
+  {
+    if(!probes[idx].success) continue;
+
+    cache_[probes[idx].serial] = probes[idx].uri;
+
+    if(probes[idx].serial == serial)
+    {
+      device = *findByUri(probes[idx].uri);
+      found = true;
+    }
+  }
+
+  save();
+
+  return found;
+}
+
+bool DeviceIndex::readSerial(const std::string& uri, std::string& serial)
+{
+  openni::Device device;
+
+  if(device.open(uri.c_str()) != openni::STATUS_OK)
+  {
+    ROS_WARN_STREAM("Failed to open device '" << uri << "' to read its serial number: " << openni::OpenNI::getExtendedError());
+    return false;
+  }
+
+  char buffer[internal::SERIAL_NUMBER_SIZE] = { 0 };
+  int size = sizeof(buffer) - 1;
+
+  bool success = device.getProperty(openni::DEVICE_PROPERTY_SERIAL_NUMBER, buffer, &size) == openni::STATUS_OK;
+  device.close();
+
+  if(success) serial = buffer;
+
+  return success;
+}
+
+void DeviceIndex::load()
+{
+  if(cache_file_.empty()) return;
+
+  std::ifstream file(cache_file_.c_str());
+  std::string serial, uri;
+
+  while(file >> serial >> uri)
+  {
+    cache_[serial] = uri;
+  }
+}
+
+void DeviceIndex::save() const
+{
+  if(cache_file_.empty()) return;
+
+  std::ostringstream content;
+
+  for(std::map<std::string, std::string>::const_iterator it = cache_.begin(); it != cache_.end(); ++it)
+  {
+    content << it->first << " " << it->second << "\n";
+  }
+
+  // other driver processes might read or write the file concurrently
+  if(!replaceFile(cache_file_, content.str()))
+  {
+    ROS_WARN_STREAM("Failed to write device index cache '" << cache_file_ << "'!");
+  }
+}
+
+} /* namespace openni2_camera */
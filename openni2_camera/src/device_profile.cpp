@@ -0,0 +1,187 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <openni2_camera/device_profile.h>
+#include <openni2_camera/device_index.h>
+
+#include <ros/console.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace openni2_camera
+{
+
+namespace internal
+{
+
+static const openni::SensorType PROFILE_SENSORS[] = { openni::SENSOR_COLOR, openni::SENSOR_DEPTH, openni::SENSOR_IR };
+
+static bool isSameMode(const openni::VideoMode& a, const openni::VideoMode& b)
+{
+  return a.getPixelFormat() == b.getPixelFormat() && a.getResolutionX() == b.getResolutionX() && a.getResolutionY() == b.getResolutionY() && a.getFps() == b.getFps();
+}
+
+} /* namespace internal */
+
+DeviceProfile::DeviceProfile() :
+  registration_supported(false)
+{
+}
+
+bool DeviceProfile::knowsSensor(openni::SensorType sensor) const
+{
+  for(size_t idx = 0; idx < modes.size(); ++idx)
+  {
+    if(modes[idx].sensor == sensor) return true;
+  }
+
+  return false;
+}
+
+bool DeviceProfile::supports(openni::SensorType sensor, const openni::VideoMode& mode) const
+{
+  for(size_t idx = 0; idx < modes.size(); ++idx)
+  {
+    if(modes[idx].sensor == sensor && internal::isSameMode(modes[idx].mode, mode)) return true;
+  }
+
+  return false;
+}
+
+std::string DeviceProfile::readProperty(openni::Device& device, int property)
+{
+  char buffer[512] = { 0 };
+  int size = sizeof(buffer) - 1;
+
+  if(device.getProperty(property, buffer, &size) != openni::STATUS_OK) return std::string();
+
+  // some properties are padded with zeros
+  return std::string(buffer);
+}
+
+void DeviceProfile::query(openni::Device& device)
+{
+  const openni::DeviceInfo& info = device.getDeviceInfo();
+
+  serial = readProperty(device, openni::DEVICE_PROPERTY_SERIAL_NUMBER);
+  firmware = readProperty(device, openni::DEVICE_PROPERTY_FIRMWARE_VERSION);
+  hardware = readProperty(device, openni::DEVICE_PROPERTY_HARDWARE_VERSION);
+  driver = readProperty(device, openni::DEVICE_PROPERTY_DRIVER_VERSION);
+  vendor = info.getVendor();
+  name = info.getName();
+  registration_supported = device.isImageRegistrationModeSupported(openni::IMAGE_REGISTRATION_DEPTH_TO_COLOR);
+
+  modes.clear();
+
+  for(size_t sidx = 0; sidx < sizeof(internal::PROFILE_SENSORS) / sizeof(internal::PROFILE_SENSORS[0]); ++sidx)
+  {
+    const openni::SensorInfo* sensor_info = device.getSensorInfo(internal::PROFILE_SENSORS[sidx]);
+
+    if(sensor_info == 0) continue;
+
+    const openni::Array<openni::VideoMode>& supported = sensor_info->getSupportedVideoModes();
+
+    for(int idx = 0; idx < supported.getSize(); ++idx)
+    {
+      Mode mode;
+      mode.sensor = internal::PROFILE_SENSORS[sidx];
+      mode.mode = supported[idx];
+      modes.push_back(mode);
+    }
+  }
+}
+
+bool DeviceProfile::load(const std::string& file, openni::Device& device)
+{
+  std::ifstream input(file.c_str());
+
+  if(!input) return false;
+
+  DeviceProfile profile;
+  std::string line;
+
+  while(std::getline(input, line))
+  {
+    std::string::size_type separator = line.find(' ');
+    std::string key = line.substr(0, separator);
+    std::string value = separator != std::string::npos ? line.substr(separator + 1) : std::string();
+
+    if(key == "serial") profile.serial = value;
+    else if(key == "firmware") profile.firmware = value;
+    else if(key == "hardware") profile.hardware = value;
+    else if(key == "driver") profile.driver = value;
+    else if(key == "vendor") profile.vendor = value;
+    else if(key == "name") profile.name = value;
+    else if(key == "registration") profile.registration_supported = (value == "1");
+    else if(key == "mode")
+    {
+      int sensor, format, x, y, fps;
+
+      if(std::sscanf(value.c_str(), "%d %d %d %d %d", &sensor, &format, &x, &y, &fps) != 5) return false;
+
+      Mode mode;
+      mode.sensor = openni::SensorType(sensor);
+      mode.mode.setPixelFormat(openni::PixelFormat(format));
+      mode.mode.setResolution(x, y);
+      mode.mode.setFps(fps);
+      profile.modes.push_back(mode);
+    }
+  }
+
+  // the versions are the only properties still read from the device
+  if(profile.firmware.empty() || profile.firmware != readProperty(device, openni::DEVICE_PROPERTY_FIRMWARE_VERSION) || profile.driver != readProperty(device, openni::DEVICE_PROPERTY_DRIVER_VERSION))
+  {
+    ROS_INFO_STREAM("Cached device profile '" << file << "' is outdated.");
+    return false;
+  }
+
+  *this = profile;
+
+  return true;
+}
+
+bool DeviceProfile::save(const std::string& file) const
+{
+  std::ostringstream output;
+
+  output << "serial " << serial << "\n";
+  output << "firmware " << firmware << "\n";
+  output << "hardware " << hardware << "\n";
+  output << "driver " << driver << "\n";
+  output << "vendor " << vendor << "\n";
+  output << "name " << name << "\n";
+  output << "registration " << (registration_supported ? 1 : 0) << "\n";
+
+  for(size_t idx = 0; idx < modes.size(); ++idx)
+  {
+    const openni::VideoMode& mode = modes[idx].mode;
+    output << "mode " << int(modes[idx].sensor) << " " << int(mode.getPixelFormat()) << " " << mode.getResolutionX() << " " << mode.getResolutionY() << " " << mode.getFps() << "\n";
+  }
+
+  // the drivers of other cameras might write their profiles concurrently
+  return replaceFile(file, output.str());
+}
+
+} /* namespace openni2_camera */
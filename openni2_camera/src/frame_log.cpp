@@ -0,0 +1,491 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <openni2_camera/frame_log.h>
+#include <openni2_camera/little_endian.h>
+
+#include <ros/console.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace openni2_camera
+{
+
+namespace internal
+{
+
+static const uint32_t FRAME_LOG_MAGIC = 0x4C464E4F; // "ONFL"
+static const uint32_t FRAME_RECORD_MAGIC = 0x52464E4F; // "ONFR"
+static const uint32_t FRAME_INDEX_MAGIC = 0x49464E4F; // "ONFI"
+static const uint32_t FRAME_LOG_VERSION = 1;
+static const size_t FRAME_LOG_HEADER_SIZE = 64;
+static const size_t FRAME_RECORD_HEADER_SIZE = 128;
+static const size_t FRAME_INDEX_ENTRY_SIZE = 16;
+static const size_t FRAME_LOG_ALIGNMENT = 64;
+static const size_t FRAME_LOG_NAME_SIZE = 32;
+
+inline size_t paddedSize(size_t size)
+{
+  return (size + FRAME_LOG_ALIGNMENT - 1) & ~(FRAME_LOG_ALIGNMENT - 1);
+}
+
+inline std::string readName(const uint8_t* p)
+{
+  const char* name = reinterpret_cast<const char*>(p);
+  return std::string(name, strnlen(name, FRAME_LOG_NAME_SIZE));
+}
+
+inline void writeName(uint8_t* p, const std::string& name)
+{
+  name.copy(reinterpret_cast<char*>(p), FRAME_LOG_NAME_SIZE - 1);
+}
+
+/**
+ * Writes all buffers, continuing after partial writes.
+ */
+bool writeAll(int fd, struct iovec* iov, int count)
+{
+  while(count > 0)
+  {
+    ssize_t written = ::writev(fd, iov, count);
+
+    if(written < 0)
+    {
+      if(errno == EINTR) continue;
+      return false;
+    }
+
+    while(count > 0 && size_t(written) >= iov->iov_len)
+    {
+      written -= ssize_t(iov->iov_len);
+      ++iov;
+      --count;
+    }
+
+    if(count > 0)
+    {
+      iov->iov_base = static_cast<uint8_t*>(iov->iov_base) + written;
+      iov->iov_len -= size_t(written);
+    }
+  }
+
+  return true;
+}
+
+bool writeFileHeader(int fd, uint32_t magic)
+{
+  uint8_t header[FRAME_LOG_HEADER_SIZE] = { 0 };
+  writeUInt32(header, magic);
+  writeUInt32(header + 4, FRAME_LOG_VERSION);
+
+  struct iovec iov = { header, sizeof(header) };
+
+  return writeAll(fd, &iov, 1);
+}
+
+bool checkFileHeader(const uint8_t* data, size_t size, uint32_t magic)
+{
+  return size >= FRAME_LOG_HEADER_SIZE && readUInt32(data) == magic && readUInt32(data + 4) == FRAME_LOG_VERSION;
+}
+
+/**
+ * Size of the complete record at offset including padding, 0 if it is cut off or corrupt.
+ */
+size_t recordSize(const uint8_t* data, size_t size, uint64_t offset)
+{
+  // compared as remaining sizes, so huge offsets from a corrupt index can not wrap
+  if(offset > size || size - offset < FRAME_RECORD_HEADER_SIZE || readUInt32(data + offset) != FRAME_RECORD_MAGIC) return 0;
+
+  uint64_t record_size = FRAME_RECORD_HEADER_SIZE + paddedSize(readUInt32(data + offset + 4));
+
+  return record_size <= size - offset ? size_t(record_size) : 0;
+}
+
+/**
+ * Maps a whole file read only, returns 0 on failure.
+ */
+const uint8_t* mapFile(const std::string& file, size_t& size)
+{
+  int fd = ::open(file.c_str(), O_RDONLY);
+
+  if(fd < 0) return 0;
+
+  struct stat info;
+  void* memory = MAP_FAILED;
+
+  if(fstat(fd, &info) == 0 && info.st_size > 0)
+  {
+    memory = mmap(0, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+  }
+
+  ::close(fd);
+
+  if(memory == MAP_FAILED) return 0;
+
+  size = size_t(info.st_size);
+
+  return static_cast<const uint8_t*>(memory);
+}
+
+} /* namespace internal */
+
+FrameLogWriter::FrameLogWriter() :
+  fd_(-1),
+  index_fd_(-1),
+  offset_(0),
+  frames_(0)
+{
+}
+
+FrameLogWriter::~FrameLogWriter()
+{
+  close();
+}
+
+bool FrameLogWriter::open(const std::string& file)
+{
+  close();
+
+  boost::mutex::scoped_lock lock(mutex_);
+
+  std::string index_file = file + ".idx";
+
+  fd_ = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  index_fd_ = ::open(index_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+  if(fd_ < 0 || index_fd_ < 0 || !internal::writeFileHeader(fd_, internal::FRAME_LOG_MAGIC) || !internal::writeFileHeader(index_fd_, internal::FRAME_INDEX_MAGIC))
+  {
+    ROS_ERROR_STREAM("Failed to create frame log '" << file << "': " << strerror(errno));
+
+    if(fd_ >= 0) ::close(fd_);
+    if(index_fd_ >= 0) ::close(index_fd_);
+    fd_ = index_fd_ = -1;
+
+    return false;
+  }
+
+  file_ = file;
+  offset_ = internal::FRAME_LOG_HEADER_SIZE;
+  frames_ = 0;
+
+  return true;
+}
+
+void FrameLogWriter::close()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  if(fd_ >= 0) ::close(fd_);
+  if(index_fd_ >= 0) ::close(index_fd_);
+
+  fd_ = index_fd_ = -1;
+}
+
+bool FrameLogWriter::isValid() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return fd_ >= 0;
+}
+
+bool FrameLogWriter::append(const FrameLogRecord& record, const uint8_t* data, size_t size)
+{
+  uint8_t header[internal::FRAME_RECORD_HEADER_SIZE] = { 0 };
+  internal::writeUInt32(header, internal::FRAME_RECORD_MAGIC);
+  internal::writeUInt32(header + 4, uint32_t(size));
+  internal::writeUInt64(header + 8, record.frame_index);
+  internal::writeUInt64(header + 16, record.device_timestamp);
+  internal::writeUInt32(header + 24, uint32_t(record.stamp.sec));
+  internal::writeUInt32(header + 28, record.stamp.nsec);
+  internal::writeUInt32(header + 32, record.width);
+  internal::writeUInt32(header + 36, record.height);
+  internal::writeUInt32(header + 40, record.step);
+  internal::writeUInt32(header + 44, uint32_t(record.pixel_format));
+  internal::writeUInt32(header + 48, uint32_t(record.fps));
+  internal::writeName(header + 52, record.stream);
+  internal::writeName(header + 52 + internal::FRAME_LOG_NAME_SIZE, record.encoding);
+
+  static const uint8_t padding[internal::FRAME_LOG_ALIGNMENT] = { 0 };
+
+  struct iovec iov[3] = {
+    { header, sizeof(header) },
+    { const_cast<uint8_t*>(data), size },
+    { const_cast<uint8_t*>(padding), internal::paddedSize(size) - size }
+  };
+
+  boost::mutex::scoped_lock lock(mutex_);
+
+  if(fd_ < 0) return false;
+
+  uint8_t entry[internal::FRAME_INDEX_ENTRY_SIZE];
+  internal::writeUInt64(entry, offset_);
+  internal::writeUInt32(entry + 8, uint32_t(record.stamp.sec));
+  internal::writeUInt32(entry + 12, record.stamp.nsec);
+
+  struct iovec index_iov = { entry, sizeof(entry) };
+
+  // the index is written last, a record without entry is recovered by the reader
+  if(!internal::writeAll(fd_, iov, 3) || !internal::writeAll(index_fd_, &index_iov, 1))
+  {
+    ROS_ERROR_STREAM("Failed to write frame log '" << file_ << "', closing it: " << strerror(errno));
+
+    ::close(fd_);
+    ::close(index_fd_);
+    fd_ = index_fd_ = -1;
+
+    return false;
+  }
+
+  offset_ += sizeof(header) + internal::paddedSize(size);
+  ++frames_;
+
+  return true;
+}
+
+uint64_t FrameLogWriter::frames() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return frames_;
+}
+
+uint64_t FrameLogWriter::bytes() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return offset_;
+}
+
+FrameLogReader::FrameLogReader() :
+  data_(0),
+  size_(0),
+  index_(0),
+  index_size_(0),
+  indexed_(0)
+{
+}
+
+FrameLogReader::~FrameLogReader()
+{
+  close();
+}
+
+bool FrameLogReader::open(const std::string& file)
+{
+  close();
+
+  data_ = internal::mapFile(file, size_);
+
+  if(data_ == 0 || !internal::checkFileHeader(data_, size_, internal::FRAME_LOG_MAGIC))
+  {
+    ROS_ERROR_STREAM("Failed to open frame log '" << file << "', it is missing or of an incompatible version!");
+    close();
+    return false;
+  }
+
+  file_ = file;
+  index_ = internal::mapFile(file + ".idx", index_size_);
+
+  if(index_ != 0 && internal::checkFileHeader(index_, index_size_, internal::FRAME_INDEX_MAGIC))
+  {
+    size_t entries = (index_size_ - internal::FRAME_LOG_HEADER_SIZE) / internal::FRAME_INDEX_ENTRY_SIZE;
+    uint64_t offset = internal::FRAME_LOG_HEADER_SIZE;
+
+    // records follow each other, the index is only used up to the first entry which does not
+    // point to the next one, e.g. of a record cut off by truncating the log
+    for(indexed_ = 0; indexed_ < entries && indexEntry(indexed_).offset == offset; ++indexed_)
+    {
+      size_t record_size = internal::recordSize(data_, size_, offset);
+
+      if(record_size == 0) break;
+
+      offset += record_size;
+    }
+  }
+  else
+  {
+    ROS_WARN_STREAM_COND(index_ != 0, "Ignoring index of frame log '" << file << "' of an incompatible version!");
+    indexed_ = 0;
+  }
+
+  recover();
+  indexStreams();
+
+  ROS_WARN_STREAM_COND(!recovered_.empty(), "Recovered " << recovered_.size() << " frames missing from the index of frame log '" << file << "'.");
+
+  return true;
+}
+
+void FrameLogReader::close()
+{
+  if(data_ != 0) munmap(const_cast<uint8_t*>(data_), size_);
+  if(index_ != 0) munmap(const_cast<uint8_t*>(index_), index_size_);
+
+  data_ = 0;
+  size_ = 0;
+  index_ = 0;
+  index_size_ = 0;
+  indexed_ = 0;
+  recovered_.clear();
+  streams_.clear();
+}
+
+void FrameLogReader::recover()
+{
+  uint64_t offset = internal::FRAME_LOG_HEADER_SIZE;
+
+  if(indexed_ > 0)
+  {
+    offset = entry(indexed_ - 1).offset;
+    offset += internal::recordSize(data_, size_, offset);
+  }
+
+  size_t record_size;
+
+  while((record_size = internal::recordSize(data_, size_, offset)) > 0)
+  {
+    Entry recovered;
+    recovered.offset = offset;
+    recovered.stamp = ros::Time(internal::readUInt32(data_ + offset + 24), internal::readUInt32(data_ + offset + 28));
+    recovered_.push_back(recovered);
+
+    offset += record_size;
+  }
+}
+
+void FrameLogReader::indexStreams()
+{
+  for(size_t idx = 0; idx < size(); ++idx)
+  {
+    streams_[internal::readName(data_ + entry(idx).offset + 52)].push_back(idx);
+  }
+}
+
+FrameLogReader::Entry FrameLogReader::entry(size_t idx) const
+{
+  return idx < indexed_ ? indexEntry(idx) : recovered_[idx - indexed_];
+}
+
+FrameLogReader::Entry FrameLogReader::indexEntry(size_t idx) const
+{
+  const uint8_t* p = index_ + internal::FRAME_LOG_HEADER_SIZE + idx * internal::FRAME_INDEX_ENTRY_SIZE;
+
+  Entry result;
+  result.offset = internal::readUInt64(p);
+  result.stamp = ros::Time(internal::readUInt32(p + 8), internal::readUInt32(p + 12));
+
+  return result;
+}
+
+size_t FrameLogReader::size() const
+{
+  return indexed_ + recovered_.size();
+}
+
+bool FrameLogReader::read(size_t idx, FrameLogView& view) const
+{
+  if(idx >= size()) return false;
+
+  uint64_t offset = entry(idx).offset;
+
+  if(internal::recordSize(data_, size_, offset) == 0) return false;
+
+  const uint8_t* header = data_ + offset;
+
+  view.record.frame_index = internal::readUInt64(header + 8);
+  view.record.device_timestamp = internal::readUInt64(header + 16);
+  view.record.stamp = ros::Time(internal::readUInt32(header + 24), internal::readUInt32(header + 28));
+  view.record.width = internal::readUInt32(header + 32);
+  view.record.height = internal::readUInt32(header + 36);
+  view.record.step = internal::readUInt32(header + 40);
+  view.record.pixel_format = int32_t(internal::readUInt32(header + 44));
+  view.record.fps = int32_t(internal::readUInt32(header + 48));
+  view.record.stream = internal::readName(header + 52);
+  view.record.encoding = internal::readName(header + 52 + internal::FRAME_LOG_NAME_SIZE);
+  view.data = header + internal::FRAME_RECORD_HEADER_SIZE;
+  view.size = internal::readUInt32(header + 4);
+
+  return true;
+}
+
+ros::Time FrameLogReader::stamp(size_t idx) const
+{
+  return entry(idx).stamp;
+}
+
+std::vector<std::string> FrameLogReader::streams() const
+{
+  std::vector<std::string> result;
+
+  for(std::map<std::string, std::vector<size_t> >::const_iterator it = streams_.begin(); it != streams_.end(); ++it)
+  {
+    result.push_back(it->first);
+  }
+
+  return result;
+}
+
+size_t FrameLogReader::find(const ros::Time& stamp, const std::string& stream) const
+{
+  std::map<std::string, std::vector<size_t> >::const_iterator frames = streams_.find(stream);
+
+  if(frames == streams_.end()) return size();
+
+  const std::vector<size_t>& indices = frames->second;
+  size_t first = 0, count = indices.size();
+
+  while(count > 0)
+  {
+    size_t step = count / 2;
+
+    if(entry(indices[first + step]).stamp < stamp)
+    {
+      first += step + 1;
+      count -= step + 1;
+    }
+    else
+    {
+      count = step;
+    }
+  }
+
+  return first < indices.size() ? indices[first] : size();
+}
+
+size_t FrameLogReader::find(const ros::Time& stamp) const
+{
+  size_t result = size();
+
+  for(std::map<std::string, std::vector<size_t> >::const_iterator it = streams_.begin(); it != streams_.end(); ++it)
+  {
+    result = std::min(result, find(stamp, it->first));
+  }
+
+  return result;
+}
+
+} /* namespace openni2_camera */
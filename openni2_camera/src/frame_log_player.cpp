@@ -0,0 +1,154 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <ros/ros.h>
+#include <sensor_msgs/Image.h>
+
+#include <openni2_camera/frame_log.h>
+
+#include <iostream>
+#include <map>
+
+/**
+ * Publishes the frames of a frame log as <stream>/image_raw in the camera namespace, like the
+ * driver would:
+ *   ~rate:            ratio to the recorded frame rate, zero or less publishes as fast as possible
+ *   ~start:           seconds to skip from the beginning of the log
+ *   ~loop:            starts over at the end of the log
+ *   ~recorded_stamps: keeps the recorded stamps instead of stamping frames when they are published
+ *   ~delay:           seconds to wait for subscribers after advertising
+ *   ~rgb_frame_id, ~depth_frame_id: as for the driver, ir frames use the depth frame
+ */
+int main(int argc, char **argv)
+{
+  using namespace openni2_camera;
+
+  ros::init(argc, argv, "frame_log_player");
+
+  if(argc < 2)
+  {
+    std::cerr << "Usage: frame_log_player <frame log>" << std::endl;
+    return 1;
+  }
+
+  ros::NodeHandle nh("camera");
+  ros::NodeHandle nh_private("~");
+
+  double rate, start, delay;
+  bool loop, recorded_stamps;
+  nh_private.param("rate", rate, 1.0);
+  nh_private.param("start", start, 0.0);
+  nh_private.param("loop", loop, false);
+  nh_private.param("recorded_stamps", recorded_stamps, false);
+  nh_private.param("delay", delay, 0.2);
+
+  std::string rgb_frame_id, depth_frame_id;
+  nh_private.param("rgb_frame_id", rgb_frame_id, std::string("camera_rgb_optical_frame"));
+  nh_private.param("depth_frame_id", depth_frame_id, std::string("camera_depth_optical_frame"));
+
+  FrameLogReader reader;
+
+  if(!reader.open(argv[1])) return 1;
+
+  if(reader.size() == 0)
+  {
+    ROS_ERROR_STREAM("Frame log '" << argv[1] << "' is empty!");
+    return 1;
+  }
+
+  ros::Time start_stamp = reader.stamp(0) + ros::Duration(start);
+  size_t first = reader.find(start_stamp);
+
+  if(first == reader.size())
+  {
+    ROS_ERROR_STREAM("Frame log '" << argv[1] << "' ends before " << start << " s!");
+    return 1;
+  }
+
+  // the streams of the first second, later ones are advertised when they appear
+  std::map<std::string, ros::Publisher> publishers;
+  FrameLogView view;
+
+  for(size_t idx = first; idx < reader.size() && reader.stamp(idx) < reader.stamp(first) + ros::Duration(1.0); ++idx)
+  {
+    if(reader.read(idx, view) && publishers.count(view.record.stream) == 0)
+    {
+      publishers[view.record.stream] = nh.advertise<sensor_msgs::Image>(view.record.stream + "/image_raw", 5);
+    }
+  }
+
+  ros::WallDuration(delay).sleep();
+
+  ROS_INFO_STREAM("Playing " << reader.size() - first << " frames of '" << argv[1] << "'.");
+
+  uint64_t published = 0;
+  ros::WallTime play_start = ros::WallTime::now();
+
+  do
+  {
+    ros::WallTime loop_start = ros::WallTime::now();
+    ros::Time loop_stamp = reader.stamp(first);
+
+    for(size_t idx = first; idx < reader.size() && ros::ok(); ++idx)
+    {
+      // frames of other streams processed after the first one may be older
+      if(!reader.read(idx, view) || view.record.stamp < start_stamp) continue;
+
+      if(rate > 0.0)
+      {
+        ros::WallTime due = loop_start + ros::WallDuration((view.record.stamp - loop_stamp).toSec() / rate);
+        ros::WallTime now = ros::WallTime::now();
+
+        if(due > now) (due - now).sleep();
+      }
+
+      std::map<std::string, ros::Publisher>::iterator publisher = publishers.find(view.record.stream);
+
+      if(publisher == publishers.end())
+      {
+        publisher = publishers.insert(std::make_pair(view.record.stream, nh.advertise<sensor_msgs::Image>(view.record.stream + "/image_raw", 5))).first;
+      }
+
+      if(publisher->second.getNumSubscribers() == 0) continue;
+
+      sensor_msgs::Image::Ptr image(new sensor_msgs::Image);
+      image->header.stamp = recorded_stamps ? view.record.stamp : ros::Time::now();
+      image->header.frame_id = view.record.stream == "rgb" ? rgb_frame_id : depth_frame_id;
+      image->width = view.record.width;
+      image->height = view.record.height;
+      image->step = view.record.step;
+      image->encoding = view.record.encoding;
+      image->data.assign(view.data, view.data + view.size);
+
+      publisher->second.publish(image);
+      ++published;
+    }
+  }
+  while(loop && ros::ok());
+
+  double duration = (ros::WallTime::now() - play_start).toSec();
+
+  ROS_INFO_STREAM("Published " << published << " frames in " << duration << " s.");
+
+  return 0;
+}
@@ -0,0 +1,122 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <openni2_camera/frame_log_queue.h>
+
+#include <ros/console.h>
+
+#include <boost/bind.hpp>
+
+namespace openni2_camera
+{
+
+FrameLogQueue::FrameLogQueue(const boost::shared_ptr<FrameLogWriter>& writer, size_t max_bytes, const ThreadOptions& options) :
+  writer_(writer),
+  max_bytes_(max_bytes),
+  bytes_(0),
+  dropped_(0),
+  stop_(false)
+{
+  thread_ = boost::thread(boost::bind(&FrameLogQueue::run, this, options));
+}
+
+FrameLogQueue::~FrameLogQueue()
+{
+  close();
+}
+
+bool FrameLogQueue::add(const FrameLogRecord& record, const sensor_msgs::ImageConstPtr& image)
+{
+  Frame frame;
+  frame.record = record;
+  frame.image = image;
+
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    // a frame larger than the limit is still written if the queue is empty
+    if(stop_ || (max_bytes_ > 0 && !queue_.empty() && bytes_ + image->data.size() > max_bytes_))
+    {
+      ++dropped_;
+      ROS_WARN_STREAM_THROTTLE(1.0, "Frame log '" << writer_->file() << "' can not keep up, dropped " << dropped_ << " frames so far!");
+      return false;
+    }
+
+    queue_.push_back(frame);
+    bytes_ += image->data.size();
+  }
+  condition_.notify_one();
+
+  return true;
+}
+
+void FrameLogQueue::close()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stop_ = true;
+  }
+  condition_.notify_one();
+
+  if(thread_.joinable()) thread_.join();
+}
+
+uint64_t FrameLogQueue::droppedFrames() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return dropped_;
+}
+
+void FrameLogQueue::run(ThreadOptions options)
+{
+  options.applyToCurrentThread();
+
+  boost::unique_lock<boost::mutex> lock(mutex_);
+
+  while(true)
+  {
+    while(queue_.empty() && !stop_)
+    {
+      condition_.wait(lock);
+    }
+
+    // the queued frames are written before stopping
+    if(queue_.empty()) break;
+
+    Frame frame = queue_.front();
+    queue_.pop_front();
+
+    // written outside the lock, the frame path only waits for the queue
+    lock.unlock();
+    writer_->append(frame.record, frame.image->data.empty() ? 0 : &frame.image->data[0], frame.image->data.size());
+    lock.lock();
+
+    bytes_ -= frame.image->data.size();
+  }
+
+  lock.unlock();
+
+  writer_->close();
+}
+
+} /* namespace openni2_camera */
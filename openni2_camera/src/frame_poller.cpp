@@ -0,0 +1,213 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <openni2_camera/frame_poller.h>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+
+namespace openni2_camera
+{
+
+namespace internal
+{
+
+// bounds how long remove() waits for a poll if no stream delivers frames
+static const int POLL_TIMEOUT_MS = 100;
+
+int batchRank(openni::SensorType type)
+{
+  switch(type)
+  {
+  case openni::SENSOR_DEPTH:
+    return 0;
+  case openni::SENSOR_COLOR:
+    return 1;
+  default:
+    return 2;
+  }
+}
+
+} /* namespace internal */
+
+FramePoller::FramePoller(const ThreadOptions& options, const ros::WallDuration& batch_window) :
+  options_(options),
+  batch_window_(batch_window),
+  polling_(false),
+  stop_(false),
+  generation_(0),
+  thread_(boost::bind(&FramePoller::run, this))
+{
+}
+
+FramePoller::~FramePoller()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stop_ = true;
+  }
+  condition_.notify_all();
+  thread_.join();
+}
+
+void FramePoller::add(openni::VideoStream& stream, const Callback& callback)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  for(size_t idx = 0; idx < entries_.size(); ++idx)
+  {
+    if(entries_[idx].stream == &stream)
+    {
+      entries_[idx].callback = callback;
+      return;
+    }
+  }
+
+  Entry entry;
+  entry.stream = &stream;
+  entry.callback = callback;
+  entry.rank = internal::batchRank(stream.getSensorInfo().getSensorType());
+  entries_.push_back(entry);
+
+  condition_.notify_all();
+}
+
+void FramePoller::remove(openni::VideoStream& stream)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  for(size_t idx = 0; idx < entries_.size(); ++idx)
+  {
+    if(entries_[idx].stream == &stream)
+    {
+      entries_.erase(entries_.begin() + idx);
+      break;
+    }
+  }
+
+  // the running poll may still use the stream, the next one does not
+  uint64_t generation = generation_;
+
+  while(polling_ && generation_ == generation)
+  {
+    condition_.wait(lock);
+  }
+}
+
+void FramePoller::readBatch(const std::vector<Entry>& entries, int first, std::vector<Frame>& batch)
+{
+  std::vector<size_t> pending;
+  std::vector<openni::VideoStream*> streams;
+
+  for(size_t idx = 0; idx < entries.size(); ++idx)
+  {
+    if(int(idx) != first) pending.push_back(idx);
+  }
+
+  ros::WallTime deadline = ros::WallTime::now() + batch_window_;
+  int ready = first;
+
+  while(true)
+  {
+    const Entry& entry = entries[ready];
+
+    batch.push_back(Frame());
+    batch.back().callback = entry.callback;
+    batch.back().rank = entry.rank;
+    entry.stream->readFrame(&batch.back().frame);
+
+    if(pending.empty()) break;
+
+    streams.clear();
+
+    for(size_t idx = 0; idx < pending.size(); ++idx)
+    {
+      streams.push_back(entries[pending[idx]].stream);
+    }
+
+    int timeout = int(std::max<int64_t>((deadline - ros::WallTime::now()).toNSec() / 1000000, 0));
+    int pending_ready;
+
+    if(openni::OpenNI::waitForAnyStream(&streams[0], int(streams.size()), &pending_ready, timeout) != openni::STATUS_OK) break;
+
+    ready = int(pending[pending_ready]);
+    pending.erase(pending.begin() + pending_ready);
+  }
+
+  std::stable_sort(batch.begin(), batch.end());
+}
+
+void FramePoller::run()
+{
+  options_.applyToCurrentThread();
+
+  std::vector<Entry> entries;
+  std::vector<openni::VideoStream*> streams;
+  std::vector<Frame> batch;
+
+  boost::unique_lock<boost::mutex> lock(mutex_);
+
+  while(!stop_)
+  {
+    if(entries_.empty())
+    {
+      condition_.wait(lock);
+      continue;
+    }
+
+    // polls without the lock, so add() and remove() never wait for frames
+    entries = entries_;
+    polling_ = true;
+    lock.unlock();
+
+    streams.clear();
+
+    for(size_t idx = 0; idx < entries.size(); ++idx)
+    {
+      streams.push_back(entries[idx].stream);
+    }
+
+    int ready;
+
+    if(openni::OpenNI::waitForAnyStream(&streams[0], int(streams.size()), &ready, internal::POLL_TIMEOUT_MS) == openni::STATUS_OK)
+    {
+      ros::Time stamp = ros::Time::now();
+      readBatch(entries, ready, batch);
+
+      for(size_t idx = 0; idx < batch.size(); ++idx)
+      {
+        batch[idx].callback(batch[idx].frame, stamp);
+      }
+
+      batch.clear();
+    }
+
+    lock.lock();
+    polling_ = false;
+    ++generation_;
+    condition_.notify_all();
+  }
+}
+
+} /* namespace openni2_camera */
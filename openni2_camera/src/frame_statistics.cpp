@@ -0,0 +1,227 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <openni2_camera/frame_statistics.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace openni2_camera
+{
+
+namespace internal
+{
+
+using namespace openni;
+
+struct DepthAccumulator
+{
+  uint64_t valid;
+  uint16_t min_value, max_value;
+  std::vector<uint32_t>& histogram;
+  uint32_t bin_size;
+
+  DepthAccumulator(std::vector<uint32_t>& h, uint32_t size) :
+    valid(0),
+    min_value(0xFFFF),
+    max_value(0),
+    histogram(h),
+    bin_size(std::max<uint32_t>(size, 1))
+  {
+  }
+
+  void add(const uint16_t* row, int width)
+  {
+    uint32_t last_bin = uint32_t(histogram.size() - 1);
+
+    for(int x = 0; x < width; ++x)
+    {
+      uint16_t v = row[x];
+
+      if(v == 0) continue;
+
+      ++valid;
+      min_value = std::min(min_value, v);
+      max_value = std::max(max_value, v);
+      ++histogram[std::min(uint32_t(v / bin_size), last_bin)];
+    }
+  }
+};
+
+struct LuminanceAccumulator
+{
+  uint64_t sum, squared_sum, saturated;
+
+  LuminanceAccumulator() :
+    sum(0),
+    squared_sum(0),
+    saturated(0)
+  {
+  }
+
+  inline void add(uint32_t luminance, bool saturated_pixel)
+  {
+    sum += luminance;
+    squared_sum += luminance * luminance;
+    saturated += saturated_pixel ? 1 : 0;
+  }
+
+  void addRGB(const uint8_t* row, int width)
+  {
+    for(int x = 0; x < width; ++x, row += 3)
+    {
+      // ITU-R BT.601 luma in fixed point
+      add((77 * row[0] + 150 * row[1] + 29 * row[2]) >> 8, row[0] == 0xFF || row[1] == 0xFF || row[2] == 0xFF);
+    }
+  }
+
+  void addUYVY(const uint8_t* row, int width)
+  {
+    // U Y0 V Y1, chroma is shared between two pixels
+    for(int x = 0; x < width; ++x)
+    {
+      uint8_t y = row[2 * x + 1];
+      add(y, y == 0xFF);
+    }
+  }
+
+  void addGray8(const uint8_t* row, int width)
+  {
+    for(int x = 0; x < width; ++x)
+    {
+      add(row[x], row[x] == 0xFF);
+    }
+  }
+
+  void addGray16(const uint16_t* row, int width, uint16_t saturation)
+  {
+    for(int x = 0; x < width; ++x)
+    {
+      add(row[x], row[x] >= saturation);
+    }
+  }
+};
+
+} /* namespace internal */
+
+FrameStatisticsCollector::FrameStatisticsCollector() :
+  histogram_bins_(16),
+  histogram_bin_size_(500),
+  saturation_value_(0xFFFF)
+{
+}
+
+void FrameStatisticsCollector::setHistogram(uint32_t bins, float max_value)
+{
+  histogram_bins_ = std::max<uint32_t>(bins, 1);
+  // round up so the bins cover max_value, the accumulator and the message use the same integer size
+  histogram_bin_size_ = std::max<uint32_t>(uint32_t(std::ceil(std::max(max_value, 1.0f) / histogram_bins_)), 1);
+}
+
+void FrameStatisticsCollector::setSaturationValue(uint16_t value)
+{
+  saturation_value_ = value;
+}
+
+void FrameStatisticsCollector::process(const openni::VideoFrameRef& frame, uint8_t* output, FrameStatistics* statistics) const
+{
+  using namespace openni;
+
+  const uint8_t* input = static_cast<const uint8_t*>(frame.getData());
+  int stride = frame.getStrideInBytes();
+  int width = frame.getWidth(), height = frame.getHeight();
+
+  if(statistics == 0)
+  {
+    std::memcpy(output, input, frame.getDataSize());
+    return;
+  }
+
+  statistics->width = width;
+  statistics->height = height;
+
+  PixelFormat format = frame.getVideoMode().getPixelFormat();
+
+  switch(format)
+  {
+  case PIXEL_FORMAT_DEPTH_1_MM:
+  case PIXEL_FORMAT_DEPTH_100_UM:
+  case PIXEL_FORMAT_SHIFT_9_2:
+  case PIXEL_FORMAT_SHIFT_9_3:
+  {
+    statistics->histogram.assign(histogram_bins_, 0);
+    statistics->histogram_bin_size = float(histogram_bin_size_);
+
+    internal::DepthAccumulator acc(statistics->histogram, histogram_bin_size_);
+
+    for(int y = 0; y < height; ++y, input += stride)
+    {
+      if(output != 0) std::memcpy(output + y * stride, input, stride);
+      acc.add(reinterpret_cast<const uint16_t*>(input), width);
+    }
+
+    statistics->valid_ratio = width * height > 0 ? float(double(acc.valid) / (double(width) * height)) : 0.0f;
+    statistics->min_value = acc.valid > 0 ? acc.min_value : 0;
+    statistics->max_value = acc.max_value;
+    break;
+  }
+  default:
+  {
+    internal::LuminanceAccumulator acc;
+
+    for(int y = 0; y < height; ++y, input += stride)
+    {
+      if(output != 0) std::memcpy(output + y * stride, input, stride);
+
+      switch(format)
+      {
+      case PIXEL_FORMAT_RGB888:
+        acc.addRGB(input, width);
+        break;
+      case PIXEL_FORMAT_YUV422:
+        acc.addUYVY(input, width);
+        break;
+      case PIXEL_FORMAT_GRAY8:
+        acc.addGray8(input, width);
+        break;
+      case PIXEL_FORMAT_GRAY16:
+        acc.addGray16(reinterpret_cast<const uint16_t*>(input), width, saturation_value_);
+        break;
+      default:
+        break;
+      }
+    }
+
+    double n = std::max(double(width) * height, 1.0);
+    double mean = acc.sum / n;
+
+    statistics->luminance_mean = float(mean);
+    statistics->luminance_variance = float(std::max(acc.squared_sum / n - mean * mean, 0.0));
+    statistics->saturated_pixels = uint32_t(acc.saturated);
+    break;
+  }
+  }
+}
+
+} /* namespace openni2_camera */
@@ -0,0 +1,274 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <openni2_camera/frame_worker.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+namespace openni2_camera
+{
+
+ThreadOptions::ThreadOptions() :
+  fifo_priority(0),
+  nice(0)
+{
+}
+
+ThreadOptions ThreadOptions::fromParameters(const ros::NodeHandle& nh, const std::string& prefix, const std::string& default_name)
+{
+  ThreadOptions options;
+  std::string affinity;
+
+  nh.param(prefix + "_thread_name", options.name, default_name);
+  nh.param(prefix + "_thread_affinity", affinity, std::string());
+  nh.param(prefix + "_thread_priority", options.fifo_priority, 0);
+  nh.param(prefix + "_thread_nice", options.nice, 0);
+
+  std::vector<std::string> cpus;
+  boost::split(cpus, affinity, boost::is_any_of(", "), boost::token_compress_on);
+
+  for(size_t idx = 0; idx < cpus.size(); ++idx)
+  {
+    if(cpus[idx].empty()) continue;
+
+    try
+    {
+      options.cpu_affinity.push_back(boost::lexical_cast<int>(cpus[idx]));
+    }
+    catch(boost::bad_lexical_cast&)
+    {
+      ROS_WARN_STREAM("Ignoring invalid cpu id '" << cpus[idx] << "' in parameter '" << prefix << "_thread_affinity'!");
+    }
+  }
+
+  return options;
+}
+
+void ThreadOptions::applyToCurrentThread() const
+{
+  pthread_t self = pthread_self();
+
+  if(!name.empty())
+  {
+    // names are limited to 16 characters including the terminator
+    int rc = pthread_setname_np(self, name.substr(0, 15).c_str());
+    ROS_WARN_STREAM_COND(rc != 0, "Failed to set name of thread '" << name << "': " << strerror(rc));
+  }
+
+  if(!cpu_affinity.empty())
+  {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+
+    for(size_t idx = 0; idx < cpu_affinity.size(); ++idx)
+    {
+      CPU_SET(cpu_affinity[idx], &cpus);
+    }
+
+    int rc = pthread_setaffinity_np(self, sizeof(cpus), &cpus);
+    ROS_WARN_STREAM_COND(rc != 0, "Failed to set cpu affinity of thread '" << name << "': " << strerror(rc));
+  }
+
+  if(fifo_priority > 0)
+  {
+    sched_param param;
+    param.sched_priority = fifo_priority;
+
+    int rc = pthread_setschedparam(self, SCHED_FIFO, &param);
+    ROS_WARN_STREAM_COND(rc != 0, "Failed to set SCHED_FIFO priority " << fifo_priority << " of thread '" << name << "': " << strerror(rc) << " (requires CAP_SYS_NICE or an rtprio limit)");
+  }
+  else if(nice != 0)
+  {
+    // on linux the nice value is a per thread attribute
+    int rc = setpriority(PRIO_PROCESS, pid_t(syscall(SYS_gettid)), nice);
+    ROS_WARN_STREAM_COND(rc != 0, "Failed to set nice value " << nice << " of thread '" << name << "': " << strerror(errno));
+  }
+}
+
+namespace internal
+{
+
+static boost::mutex shared_pool_mutex;
+static boost::weak_ptr<FrameWorkerPool> shared_pool;
+
+} /* namespace internal */
+
+FrameWorkerPool::FrameWorkerPool(const ThreadOptions& options, size_t num_threads) :
+  options_(options),
+  num_threads_(std::max<size_t>(num_threads, 1)),
+  stop_(false)
+{
+  for(size_t idx = 0; idx < num_threads_; ++idx)
+  {
+    threads_.create_thread(boost::bind(&FrameWorkerPool::run, this));
+  }
+}
+
+FrameWorkerPool::~FrameWorkerPool()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stop_ = true;
+  }
+  work_condition_.notify_all();
+  threads_.join_all();
+}
+
+boost::shared_ptr<FrameWorkerPool> FrameWorkerPool::shared(const ThreadOptions& options, size_t num_threads)
+{
+  boost::mutex::scoped_lock lock(internal::shared_pool_mutex);
+
+  boost::shared_ptr<FrameWorkerPool> pool = internal::shared_pool.lock();
+
+  if(!pool)
+  {
+    pool.reset(new FrameWorkerPool(options, num_threads));
+    internal::shared_pool = pool;
+  }
+  else
+  {
+    ROS_WARN_STREAM_COND(pool->size() != std::max<size_t>(num_threads, 1), "Shared processing pool already runs " << pool->size() << " threads, ignoring request for " << num_threads << "!");
+  }
+
+  return pool;
+}
+
+void FrameWorkerPool::run()
+{
+  options_.applyToCurrentThread();
+
+  boost::unique_lock<boost::mutex> lock(mutex_);
+
+  while(true)
+  {
+    while(queue_.empty() && !stop_)
+    {
+      work_condition_.wait(lock);
+    }
+
+    if(stop_) break;
+
+    FrameWorker* worker = queue_.front();
+    queue_.pop_front();
+
+    openni::VideoFrameRef frame = worker->pending_frame_;
+    ros::Time stamp = worker->pending_stamp_, arrival = worker->pending_arrival_;
+
+    // do not keep the driver's frame buffer alive longer than needed
+    worker->pending_frame_.release();
+    worker->has_pending_ = false;
+    worker->queued_ = false;
+    worker->active_ = true;
+
+    lock.unlock();
+    worker->callback_(frame, stamp, arrival);
+    frame.release();
+    lock.lock();
+
+    worker->active_ = false;
+
+    if(worker->has_pending_)
+    {
+      worker->queued_ = true;
+      queue_.push_back(worker);
+    }
+
+    idle_condition_.notify_all();
+  }
+}
+
+FrameWorker::FrameWorker(const ThreadOptions& options, const Callback& callback) :
+  pool_(new FrameWorkerPool(options, 1)),
+  callback_(callback),
+  has_pending_(false),
+  queued_(false),
+  active_(false)
+{
+}
+
+FrameWorker::FrameWorker(const boost::shared_ptr<FrameWorkerPool>& pool, const Callback& callback) :
+  pool_(pool),
+  callback_(callback),
+  has_pending_(false),
+  queued_(false),
+  active_(false)
+{
+}
+
+FrameWorker::~FrameWorker()
+{
+  boost::unique_lock<boost::mutex> lock(pool_->mutex_);
+
+  if(queued_)
+  {
+    pool_->queue_.erase(std::find(pool_->queue_.begin(), pool_->queue_.end(), this));
+    queued_ = false;
+  }
+
+  has_pending_ = false;
+  pending_frame_.release();
+
+  while(active_)
+  {
+    pool_->idle_condition_.wait(lock);
+  }
+}
+
+bool FrameWorker::submit(const openni::VideoFrameRef& frame, const ros::Time& stamp, const ros::Time& arrival)
+{
+  bool replaced;
+
+  {
+    boost::mutex::scoped_lock lock(pool_->mutex_);
+
+    replaced = has_pending_;
+
+    pending_frame_ = frame;
+    pending_stamp_ = stamp;
+    pending_arrival_ = arrival;
+    has_pending_ = true;
+
+    // a worker which is processing requeues itself when it is done
+    if(queued_ || active_) return replaced;
+
+    queued_ = true;
+    pool_->queue_.push_back(this);
+  }
+  pool_->work_condition_.notify_one();
+
+  return replaced;
+}
+
+} /* namespace openni2_camera */
@@ -0,0 +1,93 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <openni2_camera/openni_runtime.h>
+
+#include <ros/console.h>
+#include <openni2/OpenNI.h>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/weak_ptr.hpp>
+
+namespace openni2_camera
+{
+
+namespace internal
+{
+
+static boost::mutex runtime_mutex;
+static boost::weak_ptr<OpenNIRuntime> runtime;
+
+} /* namespace internal */
+
+boost::shared_ptr<OpenNIRuntime> OpenNIRuntime::acquire()
+{
+  boost::mutex::scoped_lock lock(internal::runtime_mutex);
+
+  boost::shared_ptr<OpenNIRuntime> result = internal::runtime.lock();
+
+  if(!result)
+  {
+    result.reset(new OpenNIRuntime());
+    internal::runtime = result;
+  }
+
+  return result;
+}
+
+OpenNIRuntime::OpenNIRuntime()
+{
+  initialized_ = (openni::OpenNI::initialize() == openni::STATUS_OK);
+
+  ROS_ERROR_STREAM_COND(!initialized_, "OpenNI2 initialization failed: " << openni::OpenNI::getExtendedError());
+}
+
+OpenNIRuntime::~OpenNIRuntime()
+{
+  // the destructor runs with runtime_mutex unlocked, so a concurrent acquire() can already
+  // initialize the next runtime; OpenNI counts initialize() calls, so this is harmless
+  openni::OpenNI::shutdown();
+}
+
+bool OpenNIRuntime::claimDevice(const std::string& uri)
+{
+  boost::mutex::scoped_lock lock(internal::runtime_mutex);
+
+  return claimed_devices_.insert(uri).second;
+}
+
+void OpenNIRuntime::releaseDevice(const std::string& uri)
+{
+  boost::mutex::scoped_lock lock(internal::runtime_mutex);
+
+  claimed_devices_.erase(uri);
+}
+
+std::set<std::string> OpenNIRuntime::claimedDevices() const
+{
+  boost::mutex::scoped_lock lock(internal::runtime_mutex);
+
+  return claimed_devices_;
+}
+
+} /* namespace openni2_camera */
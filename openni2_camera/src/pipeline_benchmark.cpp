@@ -0,0 +1,371 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <ros/message_traits.h>
+#include <ros/serialization.h>
+#include <std_msgs/Header.h>
+
+#include <openni2_camera/StreamMetrics.h>
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+namespace openni2_camera
+{
+
+/**
+ * Any message starting with a header, of which only the seq and stamp are deserialized. Like
+ * topic_tools::ShapeShifter it subscribes with the wildcard type, but the payload is skipped.
+ */
+struct StampedMessage
+{
+  typedef boost::shared_ptr<const StampedMessage> ConstPtr;
+
+  ros::Time stamp;
+};
+
+} /* namespace openni2_camera */
+
+namespace ros
+{
+namespace message_traits
+{
+
+template<> struct IsMessage<openni2_camera::StampedMessage> : TrueType {};
+
+template<> struct MD5Sum<openni2_camera::StampedMessage>
+{
+  static const char* value() { return "*"; }
+  static const char* value(const openni2_camera::StampedMessage&) { return value(); }
+};
+
+template<> struct DataType<openni2_camera::StampedMessage>
+{
+  static const char* value() { return "*"; }
+  static const char* value(const openni2_camera::StampedMessage&) { return value(); }
+};
+
+template<> struct Definition<openni2_camera::StampedMessage>
+{
+  static const char* value() { return ""; }
+  static const char* value(const openni2_camera::StampedMessage&) { return value(); }
+};
+
+} /* namespace message_traits */
+
+namespace serialization
+{
+
+template<> struct Serializer<openni2_camera::StampedMessage>
+{
+  template<typename Stream>
+  inline static void read(Stream& stream, openni2_camera::StampedMessage& message)
+  {
+    uint32_t seq;
+    stream.next(seq);
+    stream.next(message.stamp);
+  }
+
+  template<typename Stream>
+  inline static void write(Stream& stream, const openni2_camera::StampedMessage& message)
+  {
+    stream.next(uint32_t(0));
+    stream.next(message.stamp);
+  }
+
+  inline static uint32_t serializedLength(const openni2_camera::StampedMessage& message)
+  {
+    return 12;
+  }
+};
+
+} /* namespace serialization */
+} /* namespace ros */
+
+namespace openni2_camera
+{
+
+/**
+ * CPU time in seconds used by the process, or by the whole system if pid is 0.
+ */
+double readCpuTime(int pid)
+{
+  double ticks = double(sysconf(_SC_CLK_TCK));
+
+  if(pid == 0)
+  {
+    std::ifstream in("/proc/stat");
+    std::string cpu;
+    uint64_t user = 0, nice = 0, system = 0, idle = 0, iowait = 0, irq = 0, softirq = 0, steal = 0;
+    in >> cpu >> user >> nice >> system >> idle >> iowait >> irq >> softirq >> steal;
+
+    return double(user + nice + system + irq + softirq + steal) / ticks;
+  }
+
+  std::ifstream in(("/proc/" + boost::lexical_cast<std::string>(pid) + "/stat").c_str());
+  std::string line;
+  std::getline(in, line);
+
+  // the command name may contain spaces, the fields after it do not
+  size_t end = line.rfind(')');
+  if(end == std::string::npos) return 0.0;
+
+  std::istringstream fields(line.substr(end + 2));
+  std::string field;
+  uint64_t utime = 0, stime = 0;
+
+  // utime and stime are the 14th and 15th field, the state after the name is the 3rd
+  for(int idx = 3; idx < 14 && fields >> field; ++idx);
+  fields >> utime >> stime;
+
+  return double(utime + stime) / ticks;
+}
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+  if(sorted.empty()) return 0.0;
+
+  size_t idx = size_t(std::max(p * double(sorted.size()) - 1.0, 0.0) + 0.5);
+
+  return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+/**
+ * Measures how a replayed recording flows through the processing pipeline and acknowledges the
+ * frames reaching the last stage, see the ~benchmark parameter of the driver.
+ */
+class PipelineBenchmark
+{
+public:
+  PipelineBenchmark(ros::NodeHandle& nh, ros::NodeHandle& nh_private) :
+    ack_stage_(0),
+    pid_(0),
+    ack_frames_(0),
+    cpu_start_(0.0),
+    cpu_end_(0.0)
+  {
+    std::string stages, ack_stage, streams;
+    nh_private.param("stages", stages, std::string("depth/image_raw depth/image_rect_raw depth/points"));
+    nh_private.param("ack_stage", ack_stage, std::string());
+    nh_private.param("streams", streams, std::string("depth rgb"));
+    nh_private.param("pid", pid_, 0);
+
+    std::istringstream topics(stages);
+    std::string topic;
+
+    while(topics >> topic)
+    {
+      Stage stage;
+      stage.topic = topic;
+      stages_.push_back(stage);
+    }
+
+    for(size_t idx = 0; idx < stages_.size(); ++idx)
+    {
+      if(stages_[idx].topic == ack_stage || (ack_stage.empty() && idx + 1 == stages_.size())) ack_stage_ = idx;
+
+      boost::function<void(const StampedMessage::ConstPtr&)> callback = boost::bind(&PipelineBenchmark::onMessage, this, idx, _1);
+      stages_[idx].subscriber = nh.subscribe<StampedMessage>(stages_[idx].topic, 10, callback, ros::VoidConstPtr(), ros::TransportHints().tcpNoDelay());
+    }
+
+    std::istringstream names(streams);
+    std::string name;
+
+    while(names >> name)
+    {
+      dropped_frames_[name] = 0;
+
+      boost::function<void(const StreamMetrics::ConstPtr&)> callback = boost::bind(&PipelineBenchmark::onMetrics, this, name, _1);
+      metrics_subscribers_.push_back(nh.subscribe<StreamMetrics>(name + "/metrics", 1, callback));
+    }
+
+    ack_publisher_ = nh.advertise<std_msgs::Header>("benchmark_ack", 10);
+  }
+
+  bool started() const
+  {
+    return !last_message_.isZero();
+  }
+
+  ros::WallDuration idleTime() const
+  {
+    return ros::WallTime::now() - last_message_;
+  }
+
+  void report(std::ostream& out, const std::string& label) const
+  {
+    const Stage& ack = stages_[ack_stage_];
+    double duration = (ack.last - ack.first).toSec();
+    double intervals = double(std::max<uint64_t>(ack.frames, 1) - 1);
+
+    out << std::fixed << std::setprecision(3);
+    out << "label: \"" << label << "\"" << std::endl;
+    out << "ack_stage: " << ack.topic << std::endl;
+    out << "frames: " << ack.frames << std::endl;
+    out << "duration: " << duration << std::endl;
+    out << "fps: " << (duration > 0.0 ? intervals / duration : 0.0) << std::endl;
+    out << "cpu_time: " << cpu_end_ - cpu_start_ << std::endl;
+    out << "cpu_ms_per_frame: " << (intervals > 0.0 ? (cpu_end_ - cpu_start_) / intervals * 1000.0 : 0.0) << std::endl;
+    out << "cpu_scope: " << (pid_ == 0 ? std::string("system") : "pid " + boost::lexical_cast<std::string>(pid_)) << std::endl;
+
+    out << "dropped_frames:" << std::endl;
+
+    for(std::map<std::string, uint64_t>::const_iterator it = dropped_frames_.begin(); it != dropped_frames_.end(); ++it)
+    {
+      out << "  " << it->first << ": " << it->second << std::endl;
+    }
+
+    out << "stages:" << std::endl;
+
+    for(size_t idx = 0; idx < stages_.size(); ++idx)
+    {
+      const Stage& stage = stages_[idx];
+      std::vector<double> sorted(stage.latencies);
+      std::sort(sorted.begin(), sorted.end());
+
+      double stage_duration = (stage.last - stage.first).toSec();
+
+      out << "  - topic: " << stage.topic << std::endl;
+      out << "    frames: " << stage.frames << std::endl;
+      out << "    fps: " << (stage_duration > 0.0 ? double(stage.frames - 1) / stage_duration : 0.0) << std::endl;
+      out << "    latency_ms: {p50: " << percentile(sorted, 0.5) * 1000.0
+          << ", p90: " << percentile(sorted, 0.9) * 1000.0
+          << ", p99: " << percentile(sorted, 0.99) * 1000.0
+          << ", max: " << (sorted.empty() ? 0.0 : sorted.back() * 1000.0) << "}" << std::endl;
+    }
+  }
+private:
+  struct Stage
+  {
+    std::string topic;
+    ros::Subscriber subscriber;
+    uint64_t frames;
+    ros::WallTime first, last;
+    std::vector<double> latencies;
+
+    Stage() :
+      frames(0)
+    {
+    }
+  };
+
+  std::vector<Stage> stages_;
+  size_t ack_stage_;
+  int pid_;
+  ros::Publisher ack_publisher_;
+  std::vector<ros::Subscriber> metrics_subscribers_;
+  std::map<std::string, uint64_t> dropped_frames_;
+
+  ros::WallTime last_message_;
+  uint64_t ack_frames_;
+  double cpu_start_, cpu_end_;
+
+  void onMessage(size_t idx, const StampedMessage::ConstPtr& message)
+  {
+    Stage& stage = stages_[idx];
+    ros::WallTime now = ros::WallTime::now();
+
+    // frames are stamped when they arrive at the driver
+    stage.latencies.push_back((ros::Time::now() - message->stamp).toSec());
+    stage.last = now;
+    if(stage.frames++ == 0) stage.first = now;
+
+    last_message_ = now;
+
+    if(idx != ack_stage_) return;
+
+    std_msgs::Header::Ptr ack(new std_msgs::Header);
+    ack->stamp = message->stamp;
+    ack_publisher_.publish(ack);
+
+    // the CPU time is measured between the first and the last completed frame
+    cpu_end_ = readCpuTime(pid_);
+    if(ack_frames_++ == 0) cpu_start_ = cpu_end_;
+  }
+
+  void onMetrics(const std::string& stream, const StreamMetrics::ConstPtr& metrics)
+  {
+    dropped_frames_[stream] = metrics->dropped_frames + metrics->processing_dropped_frames;
+  }
+};
+
+} /* namespace openni2_camera */
+
+/**
+ * Replays are started by subscribing, the run ends after ~idle_timeout seconds without messages:
+ *   ~stages:       space separated topics relative to the node namespace, in pipeline order
+ *   ~ack_stage:    stage whose messages are acknowledged to the driver, by default the last one
+ *   ~streams:      driver streams whose dropped frames are reported, missed by the device or
+ *                  replaced before their processing thread got to them
+ *   ~pid:          process to measure the CPU time of, e.g. the nodelet manager, 0 for the system
+ *   ~label:        name of the run, e.g. the commit
+ *   ~report:       file to write the report to, it is always printed
+ */
+int main(int argc, char **argv)
+{
+  using namespace openni2_camera;
+
+  ros::init(argc, argv, "pipeline_benchmark");
+
+  ros::NodeHandle nh;
+  ros::NodeHandle nh_private("~");
+
+  double idle_timeout;
+  std::string label, report_file;
+  nh_private.param("idle_timeout", idle_timeout, 3.0);
+  nh_private.param("label", label, std::string());
+  nh_private.param("report", report_file, std::string());
+
+  PipelineBenchmark benchmark(nh, nh_private);
+
+  ROS_INFO("Waiting for the replay to start.");
+
+  while(ros::ok() && (!benchmark.started() || benchmark.idleTime().toSec() < idle_timeout))
+  {
+    ros::getGlobalCallbackQueue()->callAvailable(ros::WallDuration(0.1));
+  }
+
+  if(!benchmark.started()) return 1;
+
+  benchmark.report(std::cout, label);
+
+  if(!report_file.empty())
+  {
+    std::ofstream out(report_file.c_str());
+    benchmark.report(out, label);
+
+    ROS_ERROR_STREAM_COND(!out, "Failed to write report '" << report_file << "'!");
+  }
+
+  return 0;
+}
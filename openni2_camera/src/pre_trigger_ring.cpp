@@ -0,0 +1,177 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <openni2_camera/pre_trigger_ring.h>
+
+#include <ros/console.h>
+
+#include <sstream>
+
+namespace openni2_camera
+{
+
+namespace internal
+{
+
+// frames stamped before the end of a dump may still be in processing when it is reached
+static const double DUMP_DEADLINE_SLACK = 0.5;
+
+} /* namespace internal */
+
+PreTriggerRing::PreTriggerRing(double max_duration, size_t max_bytes, const ThreadOptions& dump_options) :
+  dump_options_(dump_options),
+  max_duration_(max_duration),
+  max_bytes_(max_bytes),
+  bytes_(0),
+  dumping_(false),
+  stop_(false)
+{
+}
+
+PreTriggerRing::~PreTriggerRing()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stop_ = true;
+    condition_.notify_one();
+  }
+
+  if(dump_thread_.joinable()) dump_thread_.join();
+}
+
+void PreTriggerRing::add(const FrameLogRecord& record, const sensor_msgs::ImageConstPtr& image)
+{
+  Frame frame;
+  frame.record = record;
+  frame.image = image;
+
+  boost::mutex::scoped_lock lock(mutex_);
+
+  ring_.push_back(frame);
+  bytes_ += image->data.size();
+
+  while(ring_.size() > 1 && ((max_bytes_ > 0 && bytes_ > max_bytes_) || (max_duration_ > 0.0 && (ring_.back().record.stamp - ring_.front().record.stamp).toSec() > max_duration_)))
+  {
+    bytes_ -= ring_.front().image->data.size();
+    ring_.pop_front();
+  }
+
+  if(dumping_ && !(dump_deadline_ < record.stamp))
+  {
+    pending_.push_back(frame);
+    condition_.notify_one();
+  }
+}
+
+bool PreTriggerRing::dump(const std::string& file, double post_duration, std::string& message)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  if(dumping_)
+  {
+    message = "Still dumping to '" + writer_->file() + "'.";
+    return false;
+  }
+
+  // the previous dump finished, its thread only has to exit
+  if(dump_thread_.joinable()) dump_thread_.join();
+
+  boost::shared_ptr<FrameLogWriter> writer(new FrameLogWriter);
+
+  if(!writer->open(file))
+  {
+    message = "Failed to create '" + file + "'.";
+    return false;
+  }
+
+  writer_ = writer;
+  pending_ = ring_;
+  dump_deadline_ = ros::Time::now() + ros::Duration(post_duration);
+  dump_wall_deadline_ = ros::WallTime::now() + ros::WallDuration(post_duration + internal::DUMP_DEADLINE_SLACK);
+  dumping_ = true;
+
+  std::ostringstream out;
+  out << "Dumping " << pending_.size() << " frames";
+  if(!pending_.empty()) out << " of " << (pending_.back().record.stamp - pending_.front().record.stamp).toSec() << " s";
+  out << " and the next " << post_duration << " s to '" << file << "'.";
+  message = out.str();
+
+  dump_thread_ = boost::thread(&PreTriggerRing::dumpLoop, this);
+
+  return true;
+}
+
+bool PreTriggerRing::isDumping() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return dumping_;
+}
+
+void PreTriggerRing::dumpLoop()
+{
+  dump_options_.applyToCurrentThread();
+
+  boost::unique_lock<boost::mutex> lock(mutex_);
+
+  boost::shared_ptr<FrameLogWriter> writer = writer_;
+  bool success = true;
+
+  while(!stop_)
+  {
+    if(pending_.empty())
+    {
+      ros::WallDuration remaining = dump_wall_deadline_ - ros::WallTime::now();
+
+      if(remaining <= ros::WallDuration(0.0)) break;
+
+      condition_.timed_wait(lock, boost::posix_time::microseconds(int64_t(remaining.toSec() * 1e6)));
+      continue;
+    }
+
+    Frame frame = pending_.front();
+    pending_.pop_front();
+
+    // written outside the lock, the frame path only waits for the queue
+    lock.unlock();
+    success = success && writer->append(frame.record, frame.image->data.empty() ? 0 : &frame.image->data[0], frame.image->data.size());
+    lock.lock();
+  }
+
+  pending_.clear();
+  dumping_ = false;
+
+  lock.unlock();
+
+  writer->close();
+
+  if(success)
+  {
+    ROS_INFO_STREAM("Dumped " << writer->frames() << " frames to '" << writer->file() << "'.");
+  }
+  else
+  {
+    ROS_ERROR_STREAM("Dump to '" << writer->file() << "' is incomplete after " << writer->frames() << " frames!");
+  }
+}
+
+} /* namespace openni2_camera */
@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <openni2_camera/published_image_registry.h>
+
+namespace openni2_camera
+{
+
+namespace internal
+{
+
+// a few frames of every stream
+static const size_t REGISTRY_SIZE = 64;
+
+} /* namespace internal */
+
+volatile int PublishedImageRegistry::enabled_ = 0;
+
+PublishedImageRegistry& PublishedImageRegistry::instance()
+{
+  static PublishedImageRegistry registry;
+  return registry;
+}
+
+void PublishedImageRegistry::enable()
+{
+  __sync_fetch_and_or(&enabled_, 1);
+}
+
+bool PublishedImageRegistry::isEnabled()
+{
+  // checked for every published frame, the registry only has to be exact once it is in use
+  return enabled_ != 0;
+}
+
+PublishedImageRegistry::PublishedImageRegistry() :
+  next_(0)
+{
+  entries_.reserve(internal::REGISTRY_SIZE);
+}
+
+void PublishedImageRegistry::add(const sensor_msgs::ImageConstPtr& image)
+{
+  Entry entry;
+  entry.message = image.get();
+  entry.data = image->data.empty() ? 0 : &image->data[0];
+  entry.stamp = image->header.stamp;
+
+  boost::mutex::scoped_lock lock(mutex_);
+
+  if(entries_.size() < internal::REGISTRY_SIZE)
+  {
+    entries_.push_back(entry);
+  }
+  else
+  {
+    entries_[next_] = entry;
+    next_ = (next_ + 1) % internal::REGISTRY_SIZE;
+  }
+}
+
+bool PublishedImageRegistry::contains(const sensor_msgs::ImageConstPtr& image) const
+{
+  // the addresses of a freed message could be reused by a copy, also comparing the data buffer
+  // and the stamp makes such a false positive practically impossible
+  const uint8_t* data = image->data.empty() ? 0 : &image->data[0];
+
+  boost::mutex::scoped_lock lock(mutex_);
+
+  for(size_t idx = 0; idx < entries_.size(); ++idx)
+  {
+    const Entry& entry = entries_[idx];
+
+    if(entry.message == image.get() && entry.data == data && entry.stamp == image->header.stamp) return true;
+  }
+
+  return false;
+}
+
+} /* namespace openni2_camera */
@@ -0,0 +1,224 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <openni2_camera/rvl_codec.h>
+
+namespace openni2_camera
+{
+
+namespace internal
+{
+
+class NibbleWriter
+{
+private:
+  uint8_t* output_;
+  uint32_t word_;
+  int nibbles_;
+
+  void flushWord()
+  {
+    output_[0] = uint8_t(word_);
+    output_[1] = uint8_t(word_ >> 8);
+    output_[2] = uint8_t(word_ >> 16);
+    output_[3] = uint8_t(word_ >> 24);
+    output_ += 4;
+  }
+public:
+  NibbleWriter(uint8_t* output) :
+    output_(output),
+    word_(0),
+    nibbles_(0)
+  {
+  }
+
+  void write(uint32_t value)
+  {
+    do
+    {
+      uint32_t nibble = value & 0x7;
+      value >>= 3;
+      if(value != 0) nibble |= 0x8;
+
+      word_ = (word_ << 4) | nibble;
+
+      if(++nibbles_ == 8)
+      {
+        flushWord();
+        word_ = 0;
+        nibbles_ = 0;
+      }
+    }
+    while(value != 0);
+  }
+
+  uint8_t* finish()
+  {
+    if(nibbles_ != 0)
+    {
+      word_ <<= 4 * (8 - nibbles_);
+      flushWord();
+      nibbles_ = 0;
+    }
+
+    return output_;
+  }
+};
+
+class NibbleReader
+{
+private:
+  const uint8_t *input_, *end_;
+  uint32_t word_;
+  int nibbles_;
+public:
+  NibbleReader(const uint8_t* input, size_t size) :
+    input_(input),
+    end_(input + (size & ~size_t(3))),
+    word_(0),
+    nibbles_(0)
+  {
+  }
+
+  bool read(uint32_t& value)
+  {
+    uint32_t nibble;
+    int shift = 0;
+    value = 0;
+
+    do
+    {
+      if(nibbles_ == 0)
+      {
+        if(input_ == end_) return false;
+
+        word_ = uint32_t(input_[0]) | (uint32_t(input_[1]) << 8) | (uint32_t(input_[2]) << 16) | (uint32_t(input_[3]) << 24);
+        input_ += 4;
+        nibbles_ = 8;
+      }
+
+      // 17 bit zigzag deltas need at most 6 nibbles, run lengths of 2^32 pixels at most 11
+      if(shift > 30) return false;
+
+      nibble = word_ >> 28;
+      value |= (nibble & 0x7) << shift;
+
+      word_ <<= 4;
+      --nibbles_;
+      shift += 3;
+    }
+    while((nibble & 0x8) != 0);
+
+    return true;
+  }
+};
+
+} /* namespace internal */
+
+size_t RvlCodec::maxEncodedSize(size_t num_pixels)
+{
+  // worst case is alternating valid and invalid pixels: 8 nibbles per pair, plus the run header and padding
+  return 4 * num_pixels + 16;
+}
+
+size_t RvlCodec::maxDecodedPixels(size_t input_size)
+{
+  // a count of n nibbles is below 2^(3n), so n nibbles in total encode fewer than 2^(3n) pixels
+  size_t nibbles = (input_size / 4) * 8;
+
+  return nibbles * 3 < sizeof(size_t) * 8 ? (size_t(1) << (nibbles * 3)) - 1 : ~size_t(0);
+}
+
+size_t RvlCodec::encode(const uint16_t* input, size_t num_pixels, uint8_t* output)
+{
+  internal::NibbleWriter writer(output);
+
+  const uint16_t* end = input + num_pixels;
+  int32_t previous = 0;
+
+  while(input != end)
+  {
+    uint32_t zeros = 0, nonzeros = 0;
+
+    for(; input != end && *input == 0; ++input, ++zeros);
+    writer.write(zeros);
+
+    for(const uint16_t* p = input; p != end && *p != 0; ++p, ++nonzeros);
+    writer.write(nonzeros);
+
+    for(uint32_t idx = 0; idx < nonzeros; ++idx, ++input)
+    {
+      int32_t current = *input;
+      int32_t delta = current - previous;
+
+      // zigzag in unsigned arithmetic, shifting a negative delta left is undefined
+      writer.write((uint32_t(delta) << 1) ^ uint32_t(delta >> 31));
+      previous = current;
+    }
+  }
+
+  return size_t(writer.finish() - output);
+}
+
+void RvlCodec::encode(const uint16_t* input, size_t num_pixels, std::vector<uint8_t>& output)
+{
+  size_t offset = output.size();
+
+  output.resize(offset + maxEncodedSize(num_pixels));
+  output.resize(offset + encode(input, num_pixels, &output[offset]));
+}
+
+bool RvlCodec::decode(const uint8_t* input, size_t input_size, uint16_t* output, size_t num_pixels)
+{
+  internal::NibbleReader reader(input, input_size);
+
+  uint16_t* end = output + num_pixels;
+  int32_t previous = 0;
+
+  while(output != end)
+  {
+    uint32_t zeros, nonzeros;
+
+    if(!reader.read(zeros) || zeros > size_t(end - output)) return false;
+
+    for(; zeros != 0; --zeros) *output++ = 0;
+
+    if(!reader.read(nonzeros) || nonzeros > size_t(end - output)) return false;
+
+    for(; nonzeros != 0; --nonzeros)
+    {
+      uint32_t positive;
+      if(!reader.read(positive)) return false;
+
+      int32_t current = previous + (int32_t(positive >> 1) ^ -int32_t(positive & 1));
+      if(current <= 0 || current > 0xFFFF) return false;
+
+      *output++ = uint16_t(current);
+      previous = current;
+    }
+  }
+
+  return true;
+}
+
+} /* namespace openni2_camera */
@@ -0,0 +1,271 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <openni2_camera/rvl_image_transport.h>
+#include <openni2_camera/rvl_codec.h>
+#include <openni2_camera/little_endian.h>
+
+#include <sensor_msgs/image_encodings.h>
+#include <pluginlib/class_list_macros.h>
+
+PLUGINLIB_DECLARE_CLASS(image_transport, rvl_pub, openni2_camera::RvlPublisher, image_transport::PublisherPlugin)
+PLUGINLIB_DECLARE_CLASS(image_transport, rvl_sub, openni2_camera::RvlSubscriber, image_transport::SubscriberPlugin)
+PLUGINLIB_DECLARE_CLASS(image_transport, rvl_lossy_pub, openni2_camera::RvlLossyPublisher, image_transport::PublisherPlugin)
+PLUGINLIB_DECLARE_CLASS(image_transport, rvl_lossy_sub, openni2_camera::RvlLossySubscriber, image_transport::SubscriberPlugin)
+
+namespace openni2_camera
+{
+
+namespace internal
+{
+
+static const size_t RVL_HEADER_SIZE = 8;
+static const size_t LOSSY_HEADER_SIZE = 20;
+
+// limits what the decoders allocate for a header, whatever it claims
+static const uint32_t RVL_MAX_DIMENSION = 1 << 16;
+static const size_t RVL_MAX_PIXELS = size_t(1) << 26;
+
+static bool hasValidDepthLayout(const sensor_msgs::Image& image)
+{
+  return size_t(image.step) >= size_t(image.width) * sizeof(uint16_t) && image.data.size() >= size_t(image.step) * image.height;
+}
+
+/**
+ * Whether the dimensions are within the limits and the payload can encode that many pixels.
+ */
+static bool hasPlausibleSize(uint32_t width, uint32_t height, size_t payload_size)
+{
+  if(width > RVL_MAX_DIMENSION || height > RVL_MAX_DIMENSION) return false;
+
+  size_t num_pixels = size_t(width) * height;
+
+  return num_pixels <= RVL_MAX_PIXELS && num_pixels <= RvlCodec::maxDecodedPixels(payload_size);
+}
+
+} /* namespace internal */
+
+bool encodeRvlImage(const sensor_msgs::Image& image, sensor_msgs::CompressedImage& compressed)
+{
+  namespace enc = sensor_msgs::image_encodings;
+
+  if(image.encoding != enc::TYPE_16UC1 && image.encoding != enc::MONO16) return false;
+  if(!internal::hasValidDepthLayout(image)) return false;
+
+  size_t row_size = image.width * sizeof(uint16_t);
+  size_t num_pixels = size_t(image.width) * image.height;
+
+  compressed.header = image.header;
+  compressed.format = image.encoding + "; rvl";
+  compressed.data.resize(internal::RVL_HEADER_SIZE);
+  internal::writeUInt32(&compressed.data[0], image.width);
+  internal::writeUInt32(&compressed.data[4], image.height);
+
+  if(num_pixels == 0) return true;
+
+  if(image.step == row_size)
+  {
+    RvlCodec::encode(reinterpret_cast<const uint16_t*>(&image.data[0]), num_pixels, compressed.data);
+  }
+  else
+  {
+    std::vector<uint16_t> packed(num_pixels);
+
+    for(uint32_t y = 0; y < image.height; ++y)
+    {
+      const uint8_t* row = &image.data[y * image.step];
+      std::copy(row, row + row_size, reinterpret_cast<uint8_t*>(&packed[y * image.width]));
+    }
+
+    RvlCodec::encode(&packed[0], num_pixels, compressed.data);
+  }
+
+  return true;
+}
+
+bool decodeRvlImage(const sensor_msgs::CompressedImage& compressed, sensor_msgs::Image& image)
+{
+  if(compressed.data.size() < internal::RVL_HEADER_SIZE) return false;
+
+  uint32_t width = internal::readUInt32(&compressed.data[0]);
+  uint32_t height = internal::readUInt32(&compressed.data[4]);
+
+  if(!internal::hasPlausibleSize(width, height, compressed.data.size() - internal::RVL_HEADER_SIZE)) return false;
+
+  image.header = compressed.header;
+  image.encoding = compressed.format.substr(0, compressed.format.find(';'));
+  image.width = width;
+  image.height = height;
+  image.is_bigendian = 0;
+  image.step = image.width * sizeof(uint16_t);
+
+  size_t num_pixels = size_t(image.width) * image.height;
+  image.data.resize(num_pixels * sizeof(uint16_t));
+
+  if(num_pixels == 0) return true;
+
+  return RvlCodec::decode(&compressed.data[internal::RVL_HEADER_SIZE], compressed.data.size() - internal::RVL_HEADER_SIZE, reinterpret_cast<uint16_t*>(&image.data[0]), num_pixels);
+}
+
+bool encodeLossyDepthImage(const sensor_msgs::Image& image, const DepthQuantizer& quantizer, sensor_msgs::CompressedImage& compressed)
+{
+  if(image.encoding != sensor_msgs::image_encodings::TYPE_16UC1) return false;
+  if(!internal::hasValidDepthLayout(image)) return false;
+
+  size_t num_pixels = size_t(image.width) * image.height;
+
+  compressed.header = image.header;
+  compressed.format = image.encoding + "; rvl_lossy";
+  compressed.data.resize(internal::LOSSY_HEADER_SIZE);
+  internal::writeUInt32(&compressed.data[0], image.width);
+  internal::writeUInt32(&compressed.data[4], image.height);
+  internal::writeFloat(&compressed.data[8], quantizer.errorScale());
+  internal::writeFloat(&compressed.data[12], quantizer.maxError());
+  internal::writeFloat(&compressed.data[16], quantizer.noiseCoefficient());
+
+  if(num_pixels == 0) return true;
+
+  std::vector<uint16_t> codes(num_pixels);
+
+  for(uint32_t y = 0; y < image.height; ++y)
+  {
+    quantizer.quantize(reinterpret_cast<const uint16_t*>(&image.data[y * image.step]), image.width, &codes[y * image.width]);
+  }
+
+  RvlCodec::encode(&codes[0], num_pixels, compressed.data);
+
+  return true;
+}
+
+bool decodeLossyDepthImage(const sensor_msgs::CompressedImage& compressed, boost::scoped_ptr<DepthQuantizer>& quantizer, sensor_msgs::Image& image)
+{
+  if(compressed.data.size() < internal::LOSSY_HEADER_SIZE) return false;
+
+  uint32_t width = internal::readUInt32(&compressed.data[0]);
+  uint32_t height = internal::readUInt32(&compressed.data[4]);
+
+  if(!internal::hasPlausibleSize(width, height, compressed.data.size() - internal::LOSSY_HEADER_SIZE)) return false;
+
+  float error_scale = internal::readFloat(&compressed.data[8]);
+  float max_error = internal::readFloat(&compressed.data[12]);
+  float noise_coefficient = internal::readFloat(&compressed.data[16]);
+
+  if(!DepthQuantizer::isValid(error_scale, max_error, noise_coefficient)) return false;
+
+  if(!quantizer || !quantizer->hasSameParameters(error_scale, max_error, noise_coefficient))
+  {
+    quantizer.reset(new DepthQuantizer(error_scale, max_error, noise_coefficient));
+  }
+
+  image.header = compressed.header;
+  image.encoding = sensor_msgs::image_encodings::TYPE_16UC1;
+  image.width = width;
+  image.height = height;
+  image.is_bigendian = 0;
+  image.step = image.width * sizeof(uint16_t);
+
+  size_t num_pixels = size_t(image.width) * image.height;
+  image.data.resize(num_pixels * sizeof(uint16_t));
+
+  if(num_pixels == 0) return true;
+
+  uint16_t* pixels = reinterpret_cast<uint16_t*>(&image.data[0]);
+
+  if(!RvlCodec::decode(&compressed.data[internal::LOSSY_HEADER_SIZE], compressed.data.size() - internal::LOSSY_HEADER_SIZE, pixels, num_pixels)) return false;
+
+  quantizer->dequantize(pixels, num_pixels, pixels);
+
+  return true;
+}
+
+void RvlPublisher::publish(const sensor_msgs::Image& message, const PublishFn& publish_fn) const
+{
+  sensor_msgs::CompressedImage compressed;
+
+  if(encodeRvlImage(message, compressed))
+  {
+    publish_fn(compressed);
+  }
+  else
+  {
+    ROS_ERROR_THROTTLE(1.0, "rvl transport only supports 16UC1 and mono16 images with step >= 2 * width and step * height bytes, got '%s' %ux%u with step %u and %lu bytes!",
+      message.encoding.c_str(), message.width, message.height, message.step, (unsigned long) message.data.size());
+  }
+}
+
+void RvlSubscriber::internalCallback(const sensor_msgs::CompressedImageConstPtr& message, const Callback& user_cb)
+{
+  sensor_msgs::Image::Ptr image(new sensor_msgs::Image);
+
+  if(decodeRvlImage(*message, *image))
+  {
+    user_cb(image);
+  }
+  else
+  {
+    ROS_ERROR_THROTTLE(1.0, "Failed to decode rvl image!");
+  }
+}
+
+void RvlLossyPublisher::publish(const sensor_msgs::Image& message, const PublishFn& publish_fn) const
+{
+  double error_scale = 0.5, max_error = 50.0, noise_coefficient = DepthQuantizer::DEFAULT_NOISE_COEFFICIENT;
+
+  // cached lookups only contact the parameter server when a value changes
+  nh().getParamCached("error_scale", error_scale);
+  nh().getParamCached("max_error", max_error);
+  nh().getParamCached("noise_coefficient", noise_coefficient);
+
+  if(!quantizer_ || !quantizer_->hasSameParameters(float(error_scale), float(max_error), float(noise_coefficient)))
+  {
+    quantizer_.reset(new DepthQuantizer(float(error_scale), float(max_error), float(noise_coefficient)));
+  }
+
+  sensor_msgs::CompressedImage compressed;
+
+  if(encodeLossyDepthImage(message, *quantizer_, compressed))
+  {
+    publish_fn(compressed);
+  }
+  else
+  {
+    ROS_ERROR_THROTTLE(1.0, "rvl_lossy transport only supports 16UC1 depth images with step >= 2 * width and step * height bytes, got '%s' %ux%u with step %u and %lu bytes!",
+      message.encoding.c_str(), message.width, message.height, message.step, (unsigned long) message.data.size());
+  }
+}
+
+void RvlLossySubscriber::internalCallback(const sensor_msgs::CompressedImageConstPtr& message, const Callback& user_cb)
+{
+  sensor_msgs::Image::Ptr image(new sensor_msgs::Image);
+
+  if(decodeLossyDepthImage(*message, quantizer_, *image))
+  {
+    user_cb(image);
+  }
+  else
+  {
+    ROS_ERROR_THROTTLE(1.0, "Failed to decode rvl_lossy image!");
+  }
+}
+
+} /* namespace openni2_camera */
@@ -0,0 +1,327 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <openni2_camera/shm_image_ring.h>
+
+#include <ros/console.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace openni2_camera
+{
+
+namespace internal
+{
+
+static const uint32_t SHM_RING_MAGIC = 0x52534E4F; // "ONSR"
+static const uint32_t SHM_RING_VERSION = 1;
+static const size_t SHM_RING_HEADER_SIZE = 4096;
+static const size_t SHM_SLOT_HEADER_SIZE = 256;
+static const size_t SHM_ENCODING_SIZE = 32;
+
+struct ShmRingHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slot_count;
+  uint32_t reserved;
+  uint64_t slot_size;
+  volatile uint64_t write_sequence;
+};
+
+struct ShmSlotHeader
+{
+  volatile uint64_t state;
+  uint32_t width;
+  uint32_t height;
+  uint32_t step;
+  uint32_t data_size;
+  int32_t stamp_sec;
+  uint32_t stamp_nsec;
+  char encoding[SHM_ENCODING_SIZE];
+};
+
+inline ShmRingHeader* ringHeader(uint8_t* base)
+{
+  return reinterpret_cast<ShmRingHeader*>(base);
+}
+
+inline const ShmRingHeader* ringHeader(const uint8_t* base)
+{
+  return reinterpret_cast<const ShmRingHeader*>(base);
+}
+
+inline uint8_t* slot(uint8_t* base, uint64_t sequence)
+{
+  const ShmRingHeader* header = ringHeader(base);
+  return base + SHM_RING_HEADER_SIZE + size_t(sequence % header->slot_count) * header->slot_size;
+}
+
+inline const uint8_t* slot(const uint8_t* base, uint64_t sequence)
+{
+  const ShmRingHeader* header = ringHeader(base);
+  return base + SHM_RING_HEADER_SIZE + size_t(sequence % header->slot_count) * header->slot_size;
+}
+
+inline uint64_t committedState(uint64_t sequence)
+{
+  return 2 * sequence + 2;
+}
+
+} /* namespace internal */
+
+ShmImageRingWriter::ShmImageRingWriter() :
+  header_(0),
+  size_(0)
+{
+}
+
+ShmImageRingWriter::~ShmImageRingWriter()
+{
+  destroy();
+}
+
+bool ShmImageRingWriter::create(const std::string& name, uint32_t slot_count, size_t slot_size)
+{
+  destroy();
+
+  // page aligned slots keep the image data aligned for the readers
+  slot_size = (internal::SHM_SLOT_HEADER_SIZE + slot_size + 4095) & ~size_t(4095);
+  size_t size = internal::SHM_RING_HEADER_SIZE + slot_size * std::max<uint32_t>(slot_count, 1);
+
+  // readers of a previous instance keep their mapping of the unlinked segment
+  shm_unlink(name.c_str());
+
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+
+  if(fd < 0)
+  {
+    ROS_ERROR_STREAM("Failed to create shared memory segment '" << name << "': " << strerror(errno));
+    return false;
+  }
+
+  void* memory = MAP_FAILED;
+
+  if(ftruncate(fd, off_t(size)) == 0)
+  {
+    memory = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+
+  int error = errno;
+  ::close(fd);
+
+  if(memory == MAP_FAILED)
+  {
+    ROS_ERROR_STREAM("Failed to map shared memory segment '" << name << "' of " << size << " bytes: " << strerror(error));
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  name_ = name;
+  header_ = static_cast<uint8_t*>(memory);
+  size_ = size;
+
+  internal::ShmRingHeader* header = internal::ringHeader(header_);
+  header->slot_count = std::max<uint32_t>(slot_count, 1);
+  header->slot_size = slot_size;
+  header->write_sequence = 0;
+  header->version = internal::SHM_RING_VERSION;
+
+  // readers check the magic last
+  __sync_synchronize();
+  header->magic = internal::SHM_RING_MAGIC;
+
+  return true;
+}
+
+void ShmImageRingWriter::destroy()
+{
+  if(header_ == 0) return;
+
+  munmap(header_, size_);
+  shm_unlink(name_.c_str());
+
+  header_ = 0;
+  size_ = 0;
+}
+
+uint32_t ShmImageRingWriter::slotCount() const
+{
+  return header_ != 0 ? internal::ringHeader(header_)->slot_count : 0;
+}
+
+size_t ShmImageRingWriter::maxImageSize() const
+{
+  return header_ != 0 ? size_t(internal::ringHeader(header_)->slot_size) - internal::SHM_SLOT_HEADER_SIZE : 0;
+}
+
+uint8_t* ShmImageRingWriter::begin(size_t size, uint64_t& sequence)
+{
+  if(header_ == 0 || size > maxImageSize()) return 0;
+
+  sequence = __sync_fetch_and_add(&internal::ringHeader(header_)->write_sequence, uint64_t(1));
+
+  uint8_t* slot = internal::slot(header_, sequence);
+  internal::ShmSlotHeader* slot_header = reinterpret_cast<internal::ShmSlotHeader*>(slot);
+
+  slot_header->state = 2 * sequence + 1;
+  __sync_synchronize();
+
+  slot_header->data_size = uint32_t(size);
+
+  return slot + internal::SHM_SLOT_HEADER_SIZE;
+}
+
+void ShmImageRingWriter::commit(uint64_t sequence, uint32_t width, uint32_t height, uint32_t step, const std::string& encoding, const ros::Time& stamp)
+{
+  internal::ShmSlotHeader* slot_header = reinterpret_cast<internal::ShmSlotHeader*>(internal::slot(header_, sequence));
+
+  slot_header->width = width;
+  slot_header->height = height;
+  slot_header->step = step;
+  slot_header->stamp_sec = int32_t(stamp.sec);
+  slot_header->stamp_nsec = stamp.nsec;
+  std::memset(slot_header->encoding, 0, internal::SHM_ENCODING_SIZE);
+  encoding.copy(slot_header->encoding, internal::SHM_ENCODING_SIZE - 1);
+
+  __sync_synchronize();
+  slot_header->state = internal::committedState(sequence);
+}
+
+ShmImageRingReader::ShmImageRingReader() :
+  header_(0),
+  size_(0)
+{
+}
+
+ShmImageRingReader::~ShmImageRingReader()
+{
+  close();
+}
+
+bool ShmImageRingReader::open(const std::string& name)
+{
+  close();
+
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+
+  if(fd < 0)
+  {
+    ROS_ERROR_STREAM("Failed to open shared memory segment '" << name << "': " << strerror(errno));
+    return false;
+  }
+
+  struct stat info;
+  void* memory = MAP_FAILED;
+
+  if(fstat(fd, &info) == 0 && size_t(info.st_size) >= internal::SHM_RING_HEADER_SIZE)
+  {
+    memory = mmap(0, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+  }
+
+  ::close(fd);
+
+  if(memory == MAP_FAILED)
+  {
+    ROS_ERROR_STREAM("Failed to map shared memory segment '" << name << "'!");
+    return false;
+  }
+
+  const internal::ShmRingHeader* header = internal::ringHeader(static_cast<const uint8_t*>(memory));
+  __sync_synchronize();
+
+  if(header->magic != internal::SHM_RING_MAGIC || header->version != internal::SHM_RING_VERSION || header->slot_count == 0 ||
+      internal::SHM_RING_HEADER_SIZE + header->slot_size * header->slot_count > uint64_t(info.st_size))
+  {
+    ROS_ERROR_STREAM("Shared memory segment '" << name << "' is no image ring of a compatible version!");
+    munmap(memory, size_t(info.st_size));
+    return false;
+  }
+
+  name_ = name;
+  header_ = static_cast<const uint8_t*>(memory);
+  size_ = size_t(info.st_size);
+
+  return true;
+}
+
+void ShmImageRingReader::close()
+{
+  if(header_ == 0) return;
+
+  munmap(const_cast<uint8_t*>(header_), size_);
+
+  header_ = 0;
+  size_ = 0;
+}
+
+ShmImageRingReader::Result ShmImageRingReader::read(uint64_t sequence, ShmImageView& view) const
+{
+  const uint8_t* slot = internal::slot(header_, sequence);
+  const internal::ShmSlotHeader* slot_header = reinterpret_cast<const internal::ShmSlotHeader*>(slot);
+
+  uint64_t state = slot_header->state;
+  __sync_synchronize();
+
+  if(state < internal::committedState(sequence)) return IMAGE_NOT_READY;
+  if(state > internal::committedState(sequence)) return IMAGE_OVERWRITTEN;
+
+  view.sequence = sequence;
+  view.width = slot_header->width;
+  view.height = slot_header->height;
+  view.step = slot_header->step;
+  view.encoding.assign(slot_header->encoding, strnlen(slot_header->encoding, internal::SHM_ENCODING_SIZE));
+  view.stamp = ros::Time(uint32_t(slot_header->stamp_sec), slot_header->stamp_nsec);
+  view.data = slot + internal::SHM_SLOT_HEADER_SIZE;
+  view.size = std::min<size_t>(slot_header->data_size, size_t(internal::ringHeader(header_)->slot_size) - internal::SHM_SLOT_HEADER_SIZE);
+
+  return isValid(view) ? IMAGE_READ : IMAGE_OVERWRITTEN;
+}
+
+bool ShmImageRingReader::isValid(const ShmImageView& view) const
+{
+  const internal::ShmSlotHeader* slot_header = reinterpret_cast<const internal::ShmSlotHeader*>(internal::slot(header_, view.sequence));
+
+  __sync_synchronize();
+  return slot_header->state == internal::committedState(view.sequence);
+}
+
+uint64_t ShmImageRingReader::lag(uint64_t sequence) const
+{
+  uint64_t written = internal::ringHeader(header_)->write_sequence;
+
+  return written > sequence + 1 ? written - sequence - 1 : 0;
+}
+
+uint32_t ShmImageRingReader::slotCount() const
+{
+  return header_ != 0 ? internal::ringHeader(header_)->slot_count : 0;
+}
+
+} /* namespace openni2_camera */
@@ -0,0 +1,282 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <openni2_camera/tile_delta_codec.h>
+#include <openni2_camera/little_endian.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace openni2_camera
+{
+
+namespace internal
+{
+
+static const uint32_t TILE_DELTA_MAGIC = 0x544C4454; // "TDLT"
+static const size_t TILE_DELTA_HEADER_SIZE = 28;
+static const uint32_t TILE_DELTA_KEYFRAME = 1;
+
+// limits what the decoder accepts, so no size computation can overflow
+static const uint32_t TILE_DELTA_MAX_DIMENSION = 1 << 16;
+static const uint32_t TILE_DELTA_MAX_BYTES_PER_PIXEL = 8;
+
+/**
+ * Whether width * height * bytes_per_pixel is at most size, computed without overflow.
+ */
+inline bool fitsInto(uint32_t width, uint32_t height, uint32_t bytes_per_pixel, size_t size)
+{
+  return width == 0 || height == 0 || size / bytes_per_pixel / width >= height;
+}
+
+inline uint32_t clampTileSize(uint32_t tile_size)
+{
+  return std::min(std::max<uint32_t>(tile_size, 1), TILE_DELTA_MAX_DIMENSION);
+}
+
+template<typename T>
+bool samplesDiffer(const T* a, const T* b, size_t n, uint32_t threshold)
+{
+  for(size_t idx = 0; idx < n; ++idx)
+  {
+    if(uint32_t(std::abs(int32_t(a[idx]) - int32_t(b[idx]))) > threshold) return true;
+  }
+
+  return false;
+}
+
+} /* namespace internal */
+
+TileDeltaEncoder::TileDeltaEncoder(uint32_t tile_size, uint32_t keyframe_interval, uint32_t threshold) :
+  tile_size_(internal::clampTileSize(tile_size)),
+  keyframe_interval_(keyframe_interval),
+  threshold_(threshold),
+  width_(0),
+  height_(0),
+  bytes_per_pixel_(0),
+  sequence_(0),
+  frames_since_keyframe_(0),
+  force_keyframe_(true)
+{
+}
+
+void TileDeltaEncoder::setParameters(uint32_t tile_size, uint32_t keyframe_interval, uint32_t threshold)
+{
+  tile_size = internal::clampTileSize(tile_size);
+
+  if(tile_size != tile_size_ || threshold != threshold_) force_keyframe_ = true;
+
+  tile_size_ = tile_size;
+  keyframe_interval_ = keyframe_interval;
+  threshold_ = threshold;
+}
+
+void TileDeltaEncoder::forceKeyframe()
+{
+  force_keyframe_ = true;
+}
+
+bool TileDeltaEncoder::tileChanged(const uint8_t* data, uint32_t step, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint32_t bytes_per_sample) const
+{
+  size_t row_size = size_t(width_) * bytes_per_pixel_;
+  size_t offset = size_t(x0) * bytes_per_pixel_;
+  size_t size = size_t(x1 - x0) * bytes_per_pixel_;
+
+  for(uint32_t y = y0; y < y1; ++y)
+  {
+    const uint8_t* current = data + size_t(y) * step + offset;
+    const uint8_t* reference = &reference_[y * row_size + offset];
+
+    if(threshold_ == 0)
+    {
+      if(std::memcmp(current, reference, size) != 0) return true;
+    }
+    else if(bytes_per_sample == 2)
+    {
+      if(internal::samplesDiffer(reinterpret_cast<const uint16_t*>(current), reinterpret_cast<const uint16_t*>(reference), size / 2, threshold_)) return true;
+    }
+    else
+    {
+      if(internal::samplesDiffer(current, reference, size, threshold_)) return true;
+    }
+  }
+
+  return false;
+}
+
+bool TileDeltaEncoder::encode(const uint8_t* data, uint32_t width, uint32_t height, uint32_t step, uint32_t bytes_per_pixel, uint32_t bytes_per_sample, std::vector<uint8_t>& output)
+{
+  size_t row_size = size_t(width) * bytes_per_pixel;
+
+  bool keyframe = force_keyframe_ || width != width_ || height != height_ || bytes_per_pixel != bytes_per_pixel_ ||
+      (keyframe_interval_ > 0 && frames_since_keyframe_ + 1 >= keyframe_interval_);
+
+  if(keyframe)
+  {
+    width_ = width;
+    height_ = height;
+    bytes_per_pixel_ = bytes_per_pixel;
+    reference_.resize(row_size * height);
+    frames_since_keyframe_ = 0;
+    force_keyframe_ = false;
+  }
+  else
+  {
+    ++frames_since_keyframe_;
+  }
+
+  uint32_t tiles_x = (width + tile_size_ - 1) / tile_size_;
+  uint32_t tiles_y = (height + tile_size_ - 1) / tile_size_;
+  size_t bitmap_size = (size_t(tiles_x) * tiles_y + 7) / 8;
+
+  output.reserve(internal::TILE_DELTA_HEADER_SIZE + bitmap_size + row_size * height);
+  output.resize(internal::TILE_DELTA_HEADER_SIZE + bitmap_size);
+  internal::writeUInt32(&output[0], internal::TILE_DELTA_MAGIC);
+  internal::writeUInt32(&output[4], width);
+  internal::writeUInt32(&output[8], height);
+  internal::writeUInt32(&output[12], bytes_per_pixel);
+  internal::writeUInt32(&output[16], tile_size_);
+  internal::writeUInt32(&output[20], sequence_++);
+  internal::writeUInt32(&output[24], keyframe ? internal::TILE_DELTA_KEYFRAME : 0);
+  std::fill(output.begin() + internal::TILE_DELTA_HEADER_SIZE, output.end(), 0);
+
+  size_t tile = 0;
+
+  for(uint32_t ty = 0; ty < tiles_y; ++ty)
+  {
+    uint32_t y0 = ty * tile_size_, y1 = std::min(y0 + tile_size_, height);
+
+    for(uint32_t tx = 0; tx < tiles_x; ++tx, ++tile)
+    {
+      uint32_t x0 = tx * tile_size_, x1 = std::min(x0 + tile_size_, width);
+
+      if(!keyframe && !tileChanged(data, step, x0, y0, x1, y1, bytes_per_sample)) continue;
+
+      output[internal::TILE_DELTA_HEADER_SIZE + tile / 8] |= uint8_t(1 << (tile % 8));
+
+      size_t offset = size_t(x0) * bytes_per_pixel;
+      size_t size = size_t(x1 - x0) * bytes_per_pixel;
+
+      for(uint32_t y = y0; y < y1; ++y)
+      {
+        const uint8_t* row = data + size_t(y) * step + offset;
+
+        output.insert(output.end(), row, row + size);
+        std::copy(row, row + size, &reference_[y * row_size + offset]);
+      }
+    }
+  }
+
+  return keyframe;
+}
+
+TileDeltaDecoder::TileDeltaDecoder() :
+  width_(0),
+  height_(0),
+  bytes_per_pixel_(0),
+  sequence_(0),
+  updated_tiles_(0),
+  synchronized_(false)
+{
+}
+
+TileDeltaDecoder::Result TileDeltaDecoder::decode(const uint8_t* input, size_t size)
+{
+  if(size < internal::TILE_DELTA_HEADER_SIZE || internal::readUInt32(input) != internal::TILE_DELTA_MAGIC) return CORRUPT_DATA;
+
+  uint32_t width = internal::readUInt32(input + 4);
+  uint32_t height = internal::readUInt32(input + 8);
+  uint32_t bytes_per_pixel = internal::readUInt32(input + 12);
+  uint32_t tile_size = internal::readUInt32(input + 16);
+  uint32_t sequence = internal::readUInt32(input + 20);
+  bool keyframe = (internal::readUInt32(input + 24) & internal::TILE_DELTA_KEYFRAME) != 0;
+
+  if(tile_size == 0 || tile_size > internal::TILE_DELTA_MAX_DIMENSION || width > internal::TILE_DELTA_MAX_DIMENSION || height > internal::TILE_DELTA_MAX_DIMENSION ||
+      bytes_per_pixel == 0 || bytes_per_pixel > internal::TILE_DELTA_MAX_BYTES_PER_PIXEL) return CORRUPT_DATA;
+
+  if(keyframe)
+  {
+    // keyframes carry every pixel, which also guards against allocating garbage sizes
+    if(!internal::fitsInto(width, height, bytes_per_pixel, size - internal::TILE_DELTA_HEADER_SIZE)) return CORRUPT_DATA;
+
+    width_ = width;
+    height_ = height;
+    bytes_per_pixel_ = bytes_per_pixel;
+    frame_.resize(size_t(width) * height * bytes_per_pixel);
+  }
+  else if(!synchronized_ || sequence != sequence_ + 1 || width != width_ || height != height_ || bytes_per_pixel != bytes_per_pixel_)
+  {
+    // a delta against a frame we do not have, wait for the next keyframe
+    synchronized_ = false;
+    return WAITING_FOR_KEYFRAME;
+  }
+
+  // a partially applied frame is unusable, so stay unsynchronized until we are done
+  synchronized_ = false;
+
+  uint32_t tiles_x = (width + tile_size - 1) / tile_size;
+  uint32_t tiles_y = (height + tile_size - 1) / tile_size;
+  size_t bitmap_size = (size_t(tiles_x) * tiles_y + 7) / 8;
+
+  if(size < internal::TILE_DELTA_HEADER_SIZE + bitmap_size) return CORRUPT_DATA;
+
+  const uint8_t* bitmap = input + internal::TILE_DELTA_HEADER_SIZE;
+  const uint8_t* payload = bitmap + bitmap_size;
+  const uint8_t* end = input + size;
+
+  size_t row_size = size_t(width) * bytes_per_pixel;
+  size_t tile = 0;
+  updated_tiles_ = 0;
+
+  for(uint32_t ty = 0; ty < tiles_y; ++ty)
+  {
+    uint32_t y0 = ty * tile_size, y1 = std::min(y0 + tile_size, height);
+
+    for(uint32_t tx = 0; tx < tiles_x; ++tx, ++tile)
+    {
+      if((bitmap[tile / 8] & (1 << (tile % 8))) == 0) continue;
+
+      uint32_t x0 = tx * tile_size, x1 = std::min(x0 + tile_size, width);
+      size_t offset = size_t(x0) * bytes_per_pixel;
+      size_t tile_row_size = size_t(x1 - x0) * bytes_per_pixel;
+
+      // the tile lies within the frame, whose size was checked with the keyframe
+      if(size_t(end - payload) / tile_row_size < (y1 - y0)) return CORRUPT_DATA;
+
+      for(uint32_t y = y0; y < y1; ++y, payload += tile_row_size)
+      {
+        std::copy(payload, payload + tile_row_size, &frame_[y * row_size + offset]);
+      }
+
+      ++updated_tiles_;
+    }
+  }
+
+  sequence_ = sequence;
+  synchronized_ = true;
+
+  return FRAME_DECODED;
+}
+
+} /* namespace openni2_camera */
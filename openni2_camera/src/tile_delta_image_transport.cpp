@@ -0,0 +1,102 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <openni2_camera/tile_delta_image_transport.h>
+
+#include <sensor_msgs/image_encodings.h>
+#include <pluginlib/class_list_macros.h>
+
+PLUGINLIB_DECLARE_CLASS(image_transport, tile_delta_pub, openni2_camera::TileDeltaPublisher, image_transport::PublisherPlugin)
+PLUGINLIB_DECLARE_CLASS(image_transport, tile_delta_sub, openni2_camera::TileDeltaSubscriber, image_transport::SubscriberPlugin)
+
+namespace openni2_camera
+{
+
+void TileDeltaPublisher::publish(const sensor_msgs::Image& message, const PublishFn& publish_fn) const
+{
+  namespace enc = sensor_msgs::image_encodings;
+
+  int tile_size = 32, keyframe_interval = 30, threshold = 0;
+  nh().getParamCached("tile_size", tile_size);
+  nh().getParamCached("keyframe_interval", keyframe_interval);
+  nh().getParamCached("threshold", threshold);
+
+  uint32_t bytes_per_sample = enc::bitDepth(message.encoding) / 8;
+  uint32_t bytes_per_pixel = bytes_per_sample * enc::numChannels(message.encoding);
+
+  if(bytes_per_sample == 0 || bytes_per_sample > 2 || message.step < message.width * bytes_per_pixel)
+  {
+    ROS_ERROR_THROTTLE(1.0, "tile_delta transport does not support images with encoding '%s'!", message.encoding.c_str());
+    return;
+  }
+
+  sensor_msgs::CompressedImage compressed;
+  compressed.header = message.header;
+  compressed.format = message.encoding + "; tile_delta";
+
+  {
+    boost::mutex::scoped_lock lock(encoder_mutex_);
+
+    encoder_.setParameters(uint32_t(std::max(tile_size, 1)), uint32_t(std::max(keyframe_interval, 0)), uint32_t(std::max(threshold, 0)));
+    encoder_.encode(message.data.empty() ? 0 : &message.data[0], message.width, message.height, message.step, bytes_per_pixel, bytes_per_sample, compressed.data);
+  }
+
+  publish_fn(compressed);
+}
+
+void TileDeltaPublisher::connectCallback(const ros::SingleSubscriberPublisher& pub)
+{
+  // the new subscriber has no reference frame yet
+  boost::mutex::scoped_lock lock(encoder_mutex_);
+  encoder_.forceKeyframe();
+}
+
+void TileDeltaSubscriber::internalCallback(const sensor_msgs::CompressedImageConstPtr& message, const Callback& user_cb)
+{
+  TileDeltaDecoder::Result result = decoder_.decode(message->data.empty() ? 0 : &message->data[0], message->data.size());
+
+  if(result == TileDeltaDecoder::CORRUPT_DATA)
+  {
+    ROS_ERROR_THROTTLE(1.0, "Failed to decode tile_delta image!");
+    return;
+  }
+
+  if(result == TileDeltaDecoder::WAITING_FOR_KEYFRAME)
+  {
+    ROS_DEBUG_THROTTLE(1.0, "tile_delta missed a frame, waiting for the next keyframe.");
+    return;
+  }
+
+  sensor_msgs::Image::Ptr image(new sensor_msgs::Image);
+  image->header = message->header;
+  image->encoding = message->format.substr(0, message->format.find(';'));
+  image->width = decoder_.width();
+  image->height = decoder_.height();
+  image->is_bigendian = 0;
+  image->step = decoder_.width() * decoder_.bytesPerPixel();
+  image->data = decoder_.frame();
+
+  user_cb(image);
+}
+
+} /* namespace openni2_camera */
@@ -0,0 +1,268 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <openni2_camera/usb_bandwidth.h>
+
+#include <ros/console.h>
+#include <openni2/PS1080.h>
+
+#include <sstream>
+
+namespace openni2_camera
+{
+
+namespace internal
+{
+
+struct InputFormat
+{
+  int format;
+  const char* name;
+  double bits_per_pixel;
+  // whether YUV422 or RGB888 output can be produced from it
+  bool yuv, rgb;
+  // smallest resolution the firmware accepts the format at, in pixels
+  int min_pixels;
+};
+
+// the firmware only streams Bayer at 1.3 or 2.0 megapixels
+static const int BAYER_MIN_PIXELS = 1280 * 1024;
+
+// ordered by increasing compression, compressed rates are averages over typical indoor scenes
+static const InputFormat IMAGE_FORMATS[] = {
+  { XN_IO_IMAGE_FORMAT_UNCOMPRESSED_YUV422, "UNCOMPRESSED_YUV422", 16.0, true, true, 0 },
+  { XN_IO_IMAGE_FORMAT_UNCOMPRESSED_YUYV, "UNCOMPRESSED_YUYV", 16.0, true, true, 0 },
+  { XN_IO_IMAGE_FORMAT_YUV422, "YUV422", 10.0, true, true, 0 },
+  { XN_IO_IMAGE_FORMAT_UNCOMPRESSED_BAYER, "UNCOMPRESSED_BAYER", 8.0, false, true, BAYER_MIN_PIXELS },
+  { XN_IO_IMAGE_FORMAT_BAYER, "BAYER", 6.0, false, true, BAYER_MIN_PIXELS },
+  { XN_IO_IMAGE_FORMAT_JPEG, "JPEG", 4.0, false, true, 0 },
+  { XN_IO_IMAGE_FORMAT_JPEG_420, "JPEG_420", 3.0, false, true, 0 },
+  { XN_IO_IMAGE_FORMAT_JPEG_MONO, "JPEG_MONO", 2.0, false, false, 0 },
+};
+
+// the 10 bit format truncates the 11 bit shift values and is not offered
+static const InputFormat DEPTH_FORMATS[] = {
+  { XN_IO_DEPTH_FORMAT_UNCOMPRESSED_16_BIT, "UNCOMPRESSED_16_BIT", 16.0, false, false, 0 },
+  { XN_IO_DEPTH_FORMAT_UNCOMPRESSED_12_BIT, "UNCOMPRESSED_12_BIT", 12.0, false, false, 0 },
+  { XN_IO_DEPTH_FORMAT_UNCOMPRESSED_11_BIT, "UNCOMPRESSED_11_BIT", 11.0, false, false, 0 },
+  { XN_IO_DEPTH_FORMAT_COMPRESSED_PS, "COMPRESSED_PS", 6.0, false, false, 0 },
+};
+
+static const InputFormat IR_FORMATS[] = {
+  { XN_IO_IR_FORMAT_UNCOMPRESSED_16_BIT, "UNCOMPRESSED_16_BIT", 16.0, false, false, 0 },
+  { XN_IO_IR_FORMAT_UNCOMPRESSED_10_BIT, "UNCOMPRESSED_10_BIT", 10.0, false, false, 0 },
+  { XN_IO_IR_FORMAT_COMPRESSED_PS, "COMPRESSED_PS", 8.0, false, false, 0 },
+};
+
+static void getInputFormats(openni::SensorType type, const InputFormat*& formats, size_t& count)
+{
+  switch(type)
+  {
+  case openni::SENSOR_COLOR:
+    formats = IMAGE_FORMATS;
+    count = sizeof(IMAGE_FORMATS) / sizeof(IMAGE_FORMATS[0]);
+    break;
+  case openni::SENSOR_DEPTH:
+    formats = DEPTH_FORMATS;
+    count = sizeof(DEPTH_FORMATS) / sizeof(DEPTH_FORMATS[0]);
+    break;
+  default:
+    formats = IR_FORMATS;
+    count = sizeof(IR_FORMATS) / sizeof(IR_FORMATS[0]);
+    break;
+  }
+}
+
+static const InputFormat* findInputFormat(openni::SensorType type, int format)
+{
+  const InputFormat* formats;
+  size_t count;
+  getInputFormats(type, formats, count);
+
+  for(size_t idx = 0; idx < count; ++idx)
+  {
+    if(formats[idx].format == format) return &formats[idx];
+  }
+
+  return 0;
+}
+
+} /* namespace internal */
+
+double estimateBandwidth(openni::SensorType type, const openni::VideoMode& mode, int input_format)
+{
+  const internal::InputFormat* format = internal::findInputFormat(type, input_format);
+
+  // unknown formats are assumed to be uncompressed
+  double bits_per_pixel = format != 0 ? format->bits_per_pixel : 16.0;
+
+  return double(mode.getResolutionX()) * mode.getResolutionY() * mode.getFps() * bits_per_pixel / 8.0;
+}
+
+std::vector<int> inputFormatCandidates(openni::SensorType type, const openni::VideoMode& mode, int current_format)
+{
+  openni::PixelFormat pixel_format = mode.getPixelFormat();
+  bool yuv_output = type == openni::SENSOR_COLOR && (pixel_format == openni::PIXEL_FORMAT_YUV422 || pixel_format == openni::PIXEL_FORMAT_YUYV);
+  bool rgb_output = type == openni::SENSOR_COLOR && pixel_format == openni::PIXEL_FORMAT_RGB888;
+  int pixels = mode.getResolutionX() * mode.getResolutionY();
+
+  const internal::InputFormat* formats;
+  size_t count;
+  internal::getInputFormats(type, formats, count);
+
+  const internal::InputFormat* current = internal::findInputFormat(type, current_format);
+  double current_bits = current != 0 ? current->bits_per_pixel : 16.0;
+
+  std::vector<int> result(1, current_format);
+
+  for(size_t idx = 0; idx < count; ++idx)
+  {
+    const internal::InputFormat& format = formats[idx];
+
+    if(format.bits_per_pixel >= current_bits || pixels < format.min_pixels) continue;
+    if((yuv_output && !format.yuv) || (rgb_output && !format.rgb)) continue;
+
+    result.push_back(format.format);
+  }
+
+  return result;
+}
+
+std::string inputFormatName(openni::SensorType type, int input_format)
+{
+  const internal::InputFormat* format = internal::findInputFormat(type, input_format);
+
+  if(format != 0) return format->name;
+
+  std::stringstream name;
+  name << "FORMAT_" << input_format;
+  return name.str();
+}
+
+UsbBandwidthPlanner& UsbBandwidthPlanner::instance()
+{
+  static UsbBandwidthPlanner planner;
+  return planner;
+}
+
+UsbBandwidthPlanner::UsbBandwidthPlanner() :
+  budget_(0.0),
+  budget_set_(false)
+{
+}
+
+void UsbBandwidthPlanner::setBudget(double budget)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  if(budget_set_)
+  {
+    ROS_WARN_STREAM_COND(budget != budget_, "Ignoring USB bus budget of " << budget / 1e6 << " MB/s, another camera of this process already set it to " << budget_ / 1e6 << " MB/s!");
+    return;
+  }
+
+  budget_ = budget;
+  budget_set_ = true;
+}
+
+double UsbBandwidthPlanner::budget() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return budget_;
+}
+
+double UsbBandwidthPlanner::allocated(unsigned bus) const
+{
+  double result = 0.0;
+
+  for(std::map<std::string, Allocation>::const_iterator it = allocations_.begin(); it != allocations_.end(); ++it)
+  {
+    if(it->second.bus == bus) result += it->second.bandwidth;
+  }
+
+  return result;
+}
+
+bool UsbBandwidthPlanner::admit(unsigned bus, const std::string& stream_id, openni::SensorType type, const std::vector<BandwidthOption>& options, size_t& chosen)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  allocations_.erase(stream_id);
+
+  if(options.empty()) return false;
+
+  double available = budget_ - allocated(bus);
+  size_t idx = 0;
+
+  if(budget_ > 0.0)
+  {
+    while(idx < options.size() && options[idx].bandwidth > available) ++idx;
+
+    if(idx == options.size())
+    {
+      ROS_ERROR_STREAM("Stream '" << stream_id << "' needs at least " << options.back().bandwidth / 1e6 << " MB/s, but only " << available / 1e6 << " of " << budget_ / 1e6 << " MB/s are left on USB bus " << bus << "!");
+      report(bus);
+      return false;
+    }
+  }
+
+  const BandwidthOption& option = options[idx];
+
+  std::stringstream description;
+  description << option.mode.getResolutionX() << "x" << option.mode.getResolutionY() << "@" << option.mode.getFps() << " " << inputFormatName(type, option.input_format);
+
+  Allocation& allocation = allocations_[stream_id];
+  allocation.bus = bus;
+  allocation.bandwidth = option.bandwidth;
+  allocation.description = description.str();
+
+  chosen = idx;
+
+  if(budget_ > 0.0) report(bus);
+
+  return true;
+}
+
+void UsbBandwidthPlanner::release(const std::string& stream_id)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  allocations_.erase(stream_id);
+}
+
+void UsbBandwidthPlanner::report(unsigned bus) const
+{
+  std::stringstream plan;
+  plan << "USB bus " << bus << " uses " << allocated(bus) / 1e6 << " of " << budget_ / 1e6 << " MB/s:";
+
+  for(std::map<std::string, Allocation>::const_iterator it = allocations_.begin(); it != allocations_.end(); ++it)
+  {
+    if(it->second.bus != bus) continue;
+
+    plan << "\n  " << it->first << " " << it->second.description << " " << it->second.bandwidth / 1e6 << " MB/s";
+  }
+
+  ROS_INFO_STREAM(plan.str());
+}
+
+} /* namespace openni2_camera */
@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <openni2_camera/zero_copy_probe_nodelet.h>
+#include <openni2_camera/published_image_registry.h>
+#include <openni2_camera/ZeroCopyReport.h>
+#include <pluginlib/class_list_macros.h>
+
+PLUGINLIB_DECLARE_CLASS(openni2_camera, zero_copy_probe_nodelet, openni2_camera::ZeroCopyProbeNodelet, nodelet::Nodelet)
+
+namespace openni2_camera
+{
+
+ZeroCopyProbeNodelet::ZeroCopyProbeNodelet() :
+  require_zero_copy_(true),
+  received_(0),
+  zero_copy_(0),
+  copied_(0)
+{
+}
+
+ZeroCopyProbeNodelet::~ZeroCopyProbeNodelet()
+{
+}
+
+void ZeroCopyProbeNodelet::onInit()
+{
+  ros::NodeHandle& nh = getNodeHandle();
+  ros::NodeHandle& nh_private = getPrivateNodeHandle();
+
+  double report_interval;
+  nh_private.param("report_interval", report_interval, 5.0);
+  nh_private.param("require_zero_copy", require_zero_copy_, true);
+
+  // the driver only remembers its images while a probe is loaded
+  PublishedImageRegistry::enable();
+
+  it_.reset(new image_transport::ImageTransport(nh));
+  report_publisher_ = nh_private.advertise<ZeroCopyReport>("report", 1, true);
+  subscriber_ = it_->subscribe("image", 1, &ZeroCopyProbeNodelet::onImage, this, image_transport::TransportHints("raw"));
+
+  report_timer_ = nh.createWallTimer(ros::WallDuration(report_interval), &ZeroCopyProbeNodelet::onReport, this);
+}
+
+void ZeroCopyProbeNodelet::onImage(const sensor_msgs::ImageConstPtr& image)
+{
+  bool zero_copy = PublishedImageRegistry::instance().contains(image);
+
+  boost::mutex::scoped_lock lock(mutex_);
+
+  ++received_;
+
+  if(zero_copy)
+  {
+    ++zero_copy_;
+  }
+  else
+  {
+    ++copied_;
+    ROS_ERROR_STREAM_COND(require_zero_copy_, "Image on '" << subscriber_.getTopic() << "' with stamp " << image->header.stamp << " was copied!");
+  }
+}
+
+void ZeroCopyProbeNodelet::onReport(const ros::WallTimerEvent& event)
+{
+  ZeroCopyReport::Ptr report(new ZeroCopyReport);
+  report->header.stamp = ros::Time::now();
+  report->topic = subscriber_.getTopic();
+
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    report->received = received_;
+    report->zero_copy = zero_copy_;
+    report->copied = copied_;
+  }
+
+  ROS_INFO_STREAM("'" << report->topic << "': " << report->received << " images received, " << report->zero_copy << " zero copy, " << report->copied << " copied.");
+
+  report_publisher_.publish(report);
+}
+
+} /* namespace openni2_camera */
@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2013 Christian Kerl <christian.kerl@in.tum.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <ros/ros.h>
+#include <openni2_camera/ZeroCopyReport.h>
+
+#include <gtest/gtest.h>
+#include <boost/bind.hpp>
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace openni2_camera
+{
+
+typedef std::map<std::string, ZeroCopyReport::ConstPtr> ReportMap;
+
+void onReport(ReportMap& reports, const std::string& probe, const ZeroCopyReport::ConstPtr& report)
+{
+  reports[probe] = report;
+}
+
+/**
+ * Every image the probes in the driver's manager received has to be the driver's own message, the
+ * probes compare the message and data buffer addresses with the published ones.
+ */
+TEST(ZeroCopy, coLoadedNodeletsReceiveDriverMessages)
+{
+  ros::NodeHandle nh, nh_private("~");
+
+  std::string probe_names;
+  int min_images;
+  double timeout;
+  nh_private.param("probes", probe_names, std::string("rgb_zero_copy_probe depth_zero_copy_probe"));
+  nh_private.param("min_images", min_images, 30);
+  nh_private.param("timeout", timeout, 60.0);
+
+  std::vector<std::string> probes;
+  std::istringstream names(probe_names);
+  std::string name;
+
+  while(names >> name) probes.push_back(name);
+
+  ASSERT_FALSE(probes.empty());
+
+  ReportMap reports;
+  std::vector<ros::Subscriber> subscribers;
+
+  for(size_t idx = 0; idx < probes.size(); ++idx)
+  {
+    boost::function<void(const ZeroCopyReport::ConstPtr&)> callback = boost::bind(&onReport, boost::ref(reports), probes[idx], _1);
+    subscribers.push_back(nh.subscribe<ZeroCopyReport>(probes[idx] + "/report", 1, callback));
+  }
+
+  ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(timeout);
+  bool done = false;
+
+  while(!done && ros::ok() && ros::WallTime::now() < deadline)
+  {
+    ros::WallDuration(0.1).sleep();
+    ros::spinOnce();
+
+    done = true;
+
+    for(size_t idx = 0; idx < probes.size(); ++idx)
+    {
+      ReportMap::const_iterator it = reports.find(probes[idx]);
+      done = done && it != reports.end() && it->second->received >= uint64_t(min_images);
+    }
+  }
+
+  for(size_t idx = 0; idx < probes.size(); ++idx)
+  {
+    ReportMap::const_iterator it = reports.find(probes[idx]);
+
+    ASSERT_TRUE(it != reports.end()) << "no report from '" << probes[idx] << "'";
+
+    const ZeroCopyReport& report = *it->second;
+
+    EXPECT_GE(report.received, uint64_t(min_images)) << report.topic;
+    EXPECT_EQ(report.received, report.zero_copy) << report.topic;
+    EXPECT_EQ(uint64_t(0), report.copied) << report.topic;
+  }
+}
+
+} /* namespace openni2_camera */
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "test_zero_copy");
+
+  return RUN_ALL_TESTS();
+}